@@ -0,0 +1,302 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "chessboard.h"
+#include "tablebase.h"
+#include "chessgame.h"
+#include "transposition.h"
+#include "search.h"
+#include "parallel.h"
+
+using namespace std;
+
+/*
+	analyze
+	searches every position of an epd file, one position per thread with
+	its own transposition table and move ordering, and writes each line back
+	in the same order with what the search found appended as epd operations:
+		pm   the best move, in san
+		ce   the score in centipawns for the side to move
+		dm   moves to mate, when the side to move mates
+		acn  nodes searched
+		acd  depth completed
+		acs  seconds spent
+	the file is memory mapped and the positions parsed straight out of it.
+	lines with a bm (best move) or am (avoid move) operation are counted as
+	solved or not, so the file can be a test suite.
+*/
+struct AnalyzeOptions {
+	int concurrency = 1;
+	int hashMegabytes = 16;
+	minimax::SearchLimits limits;
+};
+
+// a line of the mapped file, end is past its last character and before the newline
+struct Line {
+	const char* begin;
+	const char* end;
+};
+
+struct Result {
+	string operations; // appended to the line, empty for blank lines and comments
+	bool searched = false;
+	bool tested = false;
+	bool solved = false;
+	uint64_t nodes = 0;
+};
+
+const char* skipSpaces(const char* text, const char* end) {
+	while (text < end && (*text == ' ' || *text == '\t'))
+		text++;
+	return text;
+}
+
+/*
+	finds an operation of the epd operations in [text, end), each is an opcode
+	and its operands up to a semicolon. false if the line doesn't have it.
+*/
+bool findOperation(const char* text, const char* end, const char* opcode, Line& operands) {
+	const size_t length = strlen(opcode);
+	while ((text = skipSpaces(text, end)) < end) {
+		const char* opcodeEnd = text;
+		while (opcodeEnd < end && *opcodeEnd > ' ' && *opcodeEnd != ';')
+			opcodeEnd++;
+		const char* operationEnd = opcodeEnd;
+		bool quoted = false;
+		while (operationEnd < end && (quoted || *operationEnd != ';')) {
+			quoted ^= *operationEnd == '"';
+			operationEnd++;
+		}
+
+		if ((size_t) (opcodeEnd - text) == length && strncmp(text, opcode, length) == 0) {
+			operands.begin = skipSpaces(opcodeEnd, operationEnd);
+			operands.end = operationEnd;
+			return true;
+		}
+		text = operationEnd + 1;
+	}
+	return false;
+}
+
+// whether san is one of the moves of operands, check and annotation marks aside
+bool listsMove(const Line& operands, const string& san) {
+	const char* text = operands.begin;
+	while ((text = skipSpaces(text, operands.end)) < operands.end) {
+		const char* moveEnd = text;
+		while (moveEnd < operands.end && *moveEnd > ' ')
+			moveEnd++;
+		const char* markEnd = moveEnd;
+		while (markEnd > text && strchr("+#!?", markEnd[-1]))
+			markEnd--;
+
+		size_t length = san.size();
+		while (length > 0 && strchr("+#", san[length - 1]))
+			length--;
+		if ((size_t) (markEnd - text) == length && strncmp(text, san.c_str(), length) == 0)
+			return true;
+		text = moveEnd;
+	}
+	return false;
+}
+
+void analyzeLine(minimax::ParallelSearch<ChessGameTypes>& search, const Line& line, const AnalyzeOptions& options, Result& result) {
+	const char* text = skipSpaces(line.begin, line.end);
+	if (text == line.end || *text == '#')
+		return;
+
+	chess::Board board;
+	chess::Player player;
+	const char* operations = chess::parseFen(text, &board, player);
+	if (!operations || operations > line.end) {
+		result.operations = " c9 \"invalid position\";";
+		return;
+	}
+
+	// every position stands alone, only the table entries of an earlier one could help
+	search.newSearch(-1);
+	chess::Move best;
+	auto start = chrono::steady_clock::now();
+	int score = search.iterate(&board, ChessPlayer(player), options.limits, best);
+	const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	result.searched = true;
+	result.nodes = search.nodes;
+
+	// a last operation without its semicolon would run into the ones appended
+	const char* last = line.end;
+	while (last > operations && (last[-1] == ' ' || last[-1] == '\t'))
+		last--;
+	if (skipSpaces(operations, last) < last && last[-1] != ';')
+		result.operations = ";";
+
+	const int SCORE_MATE = ChessGameTypes::HeuristicType::SCORE_MATE;
+	const int MATE_BOUND = SCORE_MATE - 1000; // tablebase mates can be further off than MAX_PLY
+	const string san = best.isNull() ? string() : chess::moveToSan(&board, player, best);
+	if (!best.isNull())
+		result.operations += " pm " + san + ";";
+	result.operations += " ce " + to_string(score) + ";";
+	if (score >= MATE_BOUND)
+		result.operations += " dm " + to_string((SCORE_MATE - score + 1) / 2) + ";";
+	result.operations += " acn " + to_string(search.nodes) + "; acd " + to_string(search.completedDepth)
+		+ "; acs " + to_string((int) seconds) + ";";
+
+	Line operands;
+	if (findOperation(operations, line.end, "bm", operands)) {
+		result.tested = true;
+		result.solved = !best.isNull() && listsMove(operands, san);
+	} else if (findOperation(operations, line.end, "am", operands)) {
+		result.tested = true;
+		result.solved = !best.isNull() && !listsMove(operands, san);
+	}
+}
+
+int main(int argc, const char** args) {
+	AnalyzeOptions options;
+	options.concurrency = (int) thread::hardware_concurrency();
+	const char* inputPath = nullptr;
+	const char* outputPath = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(args[i], "-concurrency") == 0 && i + 1 < argc)
+			options.concurrency = atoi(args[++i]);
+		else if (strcmp(args[i], "-hash") == 0 && i + 1 < argc)
+			options.hashMegabytes = atoi(args[++i]);
+		else if (strcmp(args[i], "-depth") == 0 && i + 1 < argc)
+			options.limits.depth = atoi(args[++i]);
+		else if (strcmp(args[i], "-movetime") == 0 && i + 1 < argc)
+			options.limits.milliseconds = atoll(args[++i]);
+		else if (strcmp(args[i], "-nodes") == 0 && i + 1 < argc)
+			options.limits.nodes = strtoull(args[++i], nullptr, 10);
+		else if (strcmp(args[i], "-tablebases") == 0 && i + 1 < argc) {
+			if (chess::tablebases.open(args[++i]) == 0) {
+				cerr << "no tablebases found in " << args[i] << endl;
+				return 1;
+			}
+		}
+		else if (strcmp(args[i], "-nnue") == 0 && i + 1 < argc) {
+			if (!chess::nnueLoad(args[++i])) {
+				cerr << "could not load network " << args[i] << endl;
+				return 1;
+			}
+		}
+		else if (args[i][0] != '-' && !inputPath)
+			inputPath = args[i];
+		else if (args[i][0] != '-' && !outputPath)
+			outputPath = args[i];
+		else {
+			inputPath = nullptr;
+			break;
+		}
+	}
+	if (!inputPath) {
+		cerr << "usage: " << args[0] << " [-concurrency n] [-hash mb] [-depth n] [-movetime ms] [-nodes n]"
+			<< " [-tablebases dir] [-nnue file] <epd file> [output file, standard output by default]" << endl;
+		return 1;
+	}
+	if (options.concurrency < 1)
+		options.concurrency = 1;
+	if (options.limits.depth == 0 && options.limits.milliseconds == 0 && options.limits.nodes == 0) {
+		cerr << "a position needs a depth, movetime or nodes limit" << endl;
+		return 1;
+	}
+
+	int fd = open(inputPath, O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+		cerr << "could not read " << inputPath << endl;
+		return 1;
+	}
+	const size_t size = info.st_size;
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		cerr << "could not map " << inputPath << endl;
+		return 1;
+	}
+	madvise(mapping, size, MADV_SEQUENTIAL);
+
+	ofstream outputFile;
+	if (outputPath) {
+		outputFile.open(outputPath);
+		if (!outputFile) {
+			cerr << "could not open " << outputPath << endl;
+			return 1;
+		}
+	}
+	ostream& output = outputPath ? outputFile : cout;
+
+	// parsing stops at the end of a line, but a last line without a newline could end the mapping
+	const char* text = (const char*) mapping;
+	string lastLine;
+	vector<Line> lines;
+	for (const char* begin = text; begin < text + size; ) {
+		const char* end = (const char*) memchr(begin, '\n', text + size - begin);
+		if (!end) {
+			lastLine.assign(begin, text + size);
+			lines.push_back({ lastLine.c_str(), lastLine.c_str() + lastLine.size() });
+			break;
+		}
+		lines.push_back({ begin, end > begin && end[-1] == '\r' ? end - 1 : end });
+		begin = end + 1;
+	}
+
+	/*
+		results are written in the order of the file as soon as every line
+		before them is done, whichever thread finished them
+	*/
+	vector<Result> results(lines.size());
+	vector<bool> done(lines.size(), false);
+	mutex outputLock;
+	size_t written = 0;
+	int positions = 0, tested = 0, solved = 0;
+	uint64_t nodes = 0;
+	atomic<size_t> nextLine(0);
+	auto start = chrono::steady_clock::now();
+
+	vector<thread> workers;
+	for (int i = 0; i < options.concurrency; ++i) {
+		workers.emplace_back([&]() {
+			minimax::TranspositionTable table(options.hashMegabytes);
+			minimax::ParallelSearch<ChessGameTypes> search(&table, 1);
+
+			for (size_t index = nextLine++; index < lines.size(); index = nextLine++) {
+				Result result;
+				analyzeLine(search, lines[index], options, result);
+
+				lock_guard<mutex> lock(outputLock);
+				results[index] = move(result);
+				done[index] = true;
+				for (; written < lines.size() && done[written]; ++written) {
+					const Result& line = results[written];
+					output.write(lines[written].begin, lines[written].end - lines[written].begin);
+					output << line.operations << "\n";
+					positions += line.searched;
+					tested += line.tested;
+					solved += line.solved;
+					nodes += line.nodes;
+					results[written] = Result(); // the lines are never looked at again
+				}
+			}
+		});
+	}
+	for (thread& worker : workers)
+		worker.join();
+	output.flush();
+	munmap(mapping, size);
+
+	const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cerr << positions << " positions in " << (int) (seconds * 1000) << "ms with " << options.concurrency << " threads: "
+		<< (int) (positions / seconds) << " positions/s, " << (uint64_t) (nodes / seconds) << " nodes/s" << endl;
+	if (tested > 0)
+		cerr << "solved " << solved << "/" << tested << endl;
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include "bitboard.h"
+
+namespace chess {
+
+const StepAttacks stepAttacks = stepAttacksGenerate();
+
+Magic rookMagics[64];
+Magic bishopMagics[64];
+
+Bitboard betweenTable[64][64];
+Bitboard lineTable[64][64];
+
+namespace {
+
+Bitboard rookTable[0x19000];  // 102400 entries across all squares
+Bitboard bishopTable[0x1480]; // 5248 entries across all squares
+
+/*
+	walk the rays from index one square at a time, only used to build the tables
+*/
+Bitboard slidingAttacks(int index, Bitboard occupied, const int* dx, const int* dy) {
+	Bitboard attacks = 0;
+	for (int direction = 0; direction < 4; ++direction) {
+		int x = index % 8 + dx[direction];
+		int y = index / 8 + dy[direction];
+		while (x >= 0 && x < 8 && y >= 0 && y < 8) {
+			Bitboard bit = 1ULL << (x + y * 8);
+			attacks |= bit;
+			if (occupied & bit)
+				break;
+			x += dx[direction];
+			y += dy[direction];
+		}
+	}
+	return attacks;
+}
+
+inline uint64_t xorshift(uint64_t& state) {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545f4914f6cdd1dULL;
+}
+
+void initMagics(Magic* magics, Bitboard* table, const int* dx, const int* dy) {
+	const Bitboard files = 0x8181818181818181ULL; // a and h
+	Bitboard occupancies[4096];
+	Bitboard references[4096];
+	int epochs[4096] = { };
+	int epoch = 0;
+	uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+	Bitboard* attacks = table;
+	for (int index = 0; index < 64; ++index) {
+		// edges don't block anything beyond them so they are left out of the mask,
+		// unless the piece is on that edge itself
+		Bitboard edges = ((BITBOARD_RANK_1 | BITBOARD_RANK_8) & ~(BITBOARD_RANK_1 << (8 * (index / 8))))
+			| (files & ~(0x0101010101010101ULL << (index % 8)));
+
+		Magic& magic = magics[index];
+		magic.mask = slidingAttacks(index, 0, dx, dy) & ~edges;
+		magic.shift = 64 - bitboardCount(magic.mask);
+		magic.attacks = attacks;
+
+		// enumerate every subset of the mask with the carry rippler trick
+		int size = 0;
+		Bitboard occupied = 0;
+		do {
+			occupancies[size] = occupied;
+			references[size] = slidingAttacks(index, occupied, dx, dy);
+			size++;
+			occupied = (occupied - magic.mask) & magic.mask;
+		} while (occupied);
+
+#ifdef __BMI2__
+		magic.magic = 0;
+		for (int i = 0; i < size; ++i)
+			attacks[magic.getIndex(occupancies[i])] = references[i];
+#else
+		// try sparse random numbers until one maps every subset without a harmful collision
+		bool found = false;
+		while (!found) {
+			do {
+				magic.magic = xorshift(seed) & xorshift(seed) & xorshift(seed);
+			} while (bitboardCount((magic.mask * magic.magic) >> 56) < 6);
+
+			epoch++;
+			found = true;
+			for (int i = 0; i < size; ++i) {
+				unsigned slot = magic.getIndex(occupancies[i]);
+				if (epochs[slot] < epoch) {
+					epochs[slot] = epoch;
+					attacks[slot] = references[i];
+				} else if (attacks[slot] != references[i]) {
+					found = false;
+					break;
+				}
+			}
+		}
+#endif
+
+		attacks += size;
+	}
+}
+
+void initLines() {
+	for (int a = 0; a < 64; ++a) {
+		for (int b = 0; b < 64; ++b) {
+			const Bitboard ends = (1ULL << a) | (1ULL << b);
+			if (a != b && (rookAttacks(a, 0) & (1ULL << b))) {
+				lineTable[a][b] = (rookAttacks(a, 0) & rookAttacks(b, 0)) | ends;
+				betweenTable[a][b] = rookAttacks(a, 1ULL << b) & rookAttacks(b, 1ULL << a);
+			} else if (a != b && (bishopAttacks(a, 0) & (1ULL << b))) {
+				lineTable[a][b] = (bishopAttacks(a, 0) & bishopAttacks(b, 0)) | ends;
+				betweenTable[a][b] = bishopAttacks(a, 1ULL << b) & bishopAttacks(b, 1ULL << a);
+			}
+		}
+	}
+}
+
+struct MagicInitializer {
+	MagicInitializer() {
+		const int rookX[4] = { 1, -1, 0, 0 };
+		const int rookY[4] = { 0, 0, 1, -1 };
+		const int bishopX[4] = { 1, 1, -1, -1 };
+		const int bishopY[4] = { 1, -1, 1, -1 };
+		initMagics(rookMagics, rookTable, rookX, rookY);
+		initMagics(bishopMagics, bishopTable, bishopX, bishopY);
+		initLines();
+	}
+} magicInitializer;
+
+}
+
+}
@@ -0,0 +1,134 @@
+#ifndef __BITBOARD_H_
+#define __BITBOARD_H_
+
+#include <stdint.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+namespace chess {
+
+/*
+	Bitboard
+	one bit per square, bit i is square i of the board (x + y * 8)
+*/
+typedef uint64_t Bitboard;
+
+const Bitboard BITBOARD_RANK_1 = 0xffULL;
+const Bitboard BITBOARD_RANK_8 = 0xffULL << 56;
+
+inline int bitboardCount(Bitboard bitboard) {
+	return __builtin_popcountll(bitboard);
+}
+
+// index of the lowest set bit, bitboard must not be empty
+inline int bitboardFirst(Bitboard bitboard) {
+	return __builtin_ctzll(bitboard);
+}
+
+// removes and returns the lowest set bit
+inline int bitboardPop(Bitboard& bitboard) {
+	int index = __builtin_ctzll(bitboard);
+	bitboard &= bitboard - 1;
+	return index;
+}
+
+/*
+	attack tables for pieces that step rather than slide,
+	built at compile time
+*/
+struct StepAttacks {
+	Bitboard knight[64];
+	Bitboard king[64];
+	Bitboard pawn[2][64]; // captures, indexed by colour (0 moves up the board, 1 down)
+};
+
+constexpr Bitboard stepTargets(int index, const int* dx, const int* dy, int count) {
+	Bitboard targets = 0;
+	for (int i = 0; i < count; ++i) {
+		int x = index % 8 + dx[i];
+		int y = index / 8 + dy[i];
+		if (x >= 0 && x < 8 && y >= 0 && y < 8)
+			targets |= 1ULL << (x + y * 8);
+	}
+	return targets;
+}
+
+constexpr StepAttacks stepAttacksGenerate() {
+	const int knightX[8] = { 2, 1, 2, 1, -2, -1, -2, -1 };
+	const int knightY[8] = { 1, 2, -1, -2, 1, 2, -1, -2 };
+	const int kingX[8] = { -1, 1, -1, 1, 0, 0, 1, -1 };
+	const int kingY[8] = { -1, -1, 1, 1, 1, -1, 0, 0 };
+	const int pawnX[2] = { -1, 1 };
+	const int pawnUpY[2] = { 1, 1 };
+	const int pawnDownY[2] = { -1, -1 };
+
+	StepAttacks attacks = {};
+	for (int i = 0; i < 64; ++i) {
+		attacks.knight[i] = stepTargets(i, knightX, knightY, 8);
+		attacks.king[i] = stepTargets(i, kingX, kingY, 8);
+		attacks.pawn[0][i] = stepTargets(i, pawnX, pawnUpY, 2);
+		attacks.pawn[1][i] = stepTargets(i, pawnX, pawnDownY, 2);
+	}
+	return attacks;
+}
+
+extern const StepAttacks stepAttacks;
+
+/*
+	sliding attacks
+	looked up from the occupancy of the squares a piece could be blocked on,
+	through pext where the cpu has it and fancy magic multiplication otherwise.
+	the tables are filled in when the program starts.
+*/
+struct Magic {
+	Bitboard mask;     // squares whose occupancy matters
+	Bitboard magic;
+	Bitboard* attacks; // this square's slice of the shared table
+	unsigned shift;
+
+	inline unsigned getIndex(Bitboard occupied) const {
+#ifdef __BMI2__
+		return (unsigned) _pext_u64(occupied, mask);
+#else
+		return (unsigned) (((occupied & mask) * magic) >> shift);
+#endif
+	}
+};
+
+extern Magic rookMagics[64];
+extern Magic bishopMagics[64];
+
+inline Bitboard rookAttacks(int index, Bitboard occupied) {
+	const Magic& magic = rookMagics[index];
+	return magic.attacks[magic.getIndex(occupied)];
+}
+
+inline Bitboard bishopAttacks(int index, Bitboard occupied) {
+	const Magic& magic = bishopMagics[index];
+	return magic.attacks[magic.getIndex(occupied)];
+}
+
+inline Bitboard queenAttacks(int index, Bitboard occupied) {
+	return rookAttacks(index, occupied) | bishopAttacks(index, occupied);
+}
+
+/*
+	squares strictly between two squares on a rank, file or diagonal, and the
+	whole line through them, empty when the squares don't share one.
+	filled in with the magics.
+*/
+extern Bitboard betweenTable[64][64];
+extern Bitboard lineTable[64][64];
+
+inline Bitboard bitboardBetween(int a, int b) {
+	return betweenTable[a][b];
+}
+
+inline Bitboard bitboardLine(int a, int b) {
+	return lineTable[a][b];
+}
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "book.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace chess {
+
+bool OpeningBook::open(const char* path) {
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0 || info.st_size % sizeof(BookEntry) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+
+	close();
+	entries = (const BookEntry*) mapping;
+	count = info.st_size / sizeof(BookEntry);
+	return true;
+}
+
+void OpeningBook::close() {
+	if (entries)
+		munmap((void*) entries, count * sizeof(BookEntry));
+	entries = nullptr;
+	count = 0;
+}
+
+bool OpeningBook::probe(const Board* board, Player player, uint32_t random, Move& move) const {
+	if (!entries)
+		return false;
+
+	// first entry with the key
+	const uint64_t key = bookKey(board, player);
+	size_t low = 0, high = count;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (entries[middle].key < key)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	// a different position can share the key, so only legal moves count
+	uint32_t total = 0;
+	size_t end = low;
+	for (; end < count && entries[end].key == key; ++end) {
+		if (isLegal(board, player, Move(entries[end].move)))
+			total += entries[end].weight;
+	}
+	if (total == 0)
+		return false;
+
+	uint32_t roll = random % total;
+	for (size_t i = low; i < end; ++i) {
+		const Move candidate(entries[i].move);
+		if (!isLegal(board, player, candidate))
+			continue;
+		if (roll < entries[i].weight) {
+			move = candidate;
+			return true;
+		}
+		roll -= entries[i].weight;
+	}
+	return false;
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef __BOOK_H_
+#define __BOOK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "chessboard.h"
+
+namespace chess {
+
+/*
+	BookEntry
+	one move known for one position, the book file is an array of these sorted
+	by key and then by move, little endian
+*/
+struct BookEntry {
+	uint64_t key;    // zobrist hash of the position, see bookKey
+	uint16_t move;   // packed Move
+	uint16_t weight; // how often the move was played, moves are picked in proportion
+	uint32_t reserved;
+};
+
+static_assert(sizeof(BookEntry) == 16, "book entries are stored as 16 bytes");
+
+// the board's hash with the player to move folded in, like the search's keys
+inline uint64_t bookKey(const Board* board, Player player) {
+	return board->getHash() ^ (player < 0 ? zobrist.side : 0);
+}
+
+/*
+	OpeningBook
+	a book file mapped into memory read only, so every engine process shares
+	one copy and a probe is a binary search with no allocation
+*/
+struct OpeningBook {
+	OpeningBook() : entries(nullptr), count(0) { }
+
+	~OpeningBook() {
+		close();
+	}
+
+	OpeningBook(const OpeningBook&) = delete;
+	OpeningBook& operator=(const OpeningBook&) = delete;
+
+	// maps the book at path, false if it can't be read or isn't a whole number of entries
+	bool open(const char* path);
+	void close();
+
+	inline bool isOpen() const {
+		return entries != nullptr;
+	}
+
+	inline size_t size() const {
+		return count;
+	}
+
+	/*
+		picks one of the book moves for the position, weighted by how often each
+		was played, using random as the dice roll.
+		false if the position isn't in the book or no stored move is legal in it.
+	*/
+	bool probe(const Board* board, Player player, uint32_t random, Move& move) const;
+
+private:
+	const BookEntry* entries;
+	size_t count;
+};
+
+}
+
+#endif
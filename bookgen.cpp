@@ -0,0 +1,89 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstring>
+#include <cstdlib>
+#include "book.h"
+
+using namespace std;
+
+/*
+	bookgen
+	builds an opening book from a list of games, one per line as moves in
+	coordinate notation from the start position ("e2e4 e7e5 g1f3 ..."),
+	blank lines and lines starting with # are skipped. every position in the
+	first plies of each game gets the move played in it, weighted by how many
+	games played it there.
+*/
+int main(int argc, const char** args) {
+	int plies = 20;
+	const char* gamesPath = nullptr;
+	const char* bookPath = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(args[i], "-plies") == 0 && i + 1 < argc)
+			plies = atoi(args[++i]);
+		else if (!gamesPath)
+			gamesPath = args[i];
+		else
+			bookPath = args[i];
+	}
+	if (!gamesPath || !bookPath) {
+		cerr << "usage: " << args[0] << " [-plies n] <games file> <book file>" << endl;
+		return 1;
+	}
+
+	ifstream games(gamesPath);
+	if (!games) {
+		cerr << "could not read " << gamesPath << endl;
+		return 1;
+	}
+
+	map<pair<uint64_t, uint16_t>, uint32_t> counts;
+	string line;
+	int lineNumber = 0, gameCount = 0;
+	while (getline(games, line)) {
+		lineNumber++;
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		chess::Board board;
+		chess::Player player = 1;
+		istringstream moves(line);
+		string text;
+		for (int ply = 0; ply < plies && moves >> text; ++ply) {
+			chess::Move move;
+			if (!chess::parseMove(&board, player, text, move)) {
+				cerr << gamesPath << ":" << lineNumber << ": illegal move " << text << endl;
+				return 1;
+			}
+			counts[make_pair(chess::bookKey(&board, player), move.pack())]++;
+
+			chess::Move::Undo undo;
+			move.apply(&board, undo);
+			player = -player;
+		}
+		gameCount++;
+	}
+
+	// the map is already in key then move order
+	vector<chess::BookEntry> entries;
+	entries.reserve(counts.size());
+	for (const auto& count : counts) {
+		chess::BookEntry entry = { count.first.first, count.first.second, (uint16_t) (count.second < UINT16_MAX ? count.second : UINT16_MAX), 0 };
+		entries.push_back(entry);
+	}
+
+	ofstream book(bookPath, ios::binary);
+	book.write((const char*) entries.data(), entries.size() * sizeof(chess::BookEntry));
+	if (!book) {
+		cerr << "could not write " << bookPath << endl;
+		return 1;
+	}
+
+	cout << gameCount << " games, " << entries.size() << " book entries" << endl;
+	return 0;
+}
@@ -6,6 +6,8 @@
 
 namespace chess {
 
+const ZobristKeys zobrist = zobristGenerate();
+const PieceSquareTables pieceSquareTables = pieceSquareTablesGenerate();
 
 /*
 	Methods for Board
@@ -33,9 +35,45 @@ Board::Board() {
 	this->pieces[blackOffset + 2] = this->pieces[blackOffset + 5] = -PIECE_BISHOP;
 	this->pieces[blackOffset + 3] = -PIECE_QUEEN;
 	this->pieces[blackOffset + 4] = -PIECE_KING;
+
+	this->castling = CASTLE_ALL;
+	this->enPassant = -1;
+	synchronize();
+}
+
+void Board::synchronize() {
+	for (int i = 0; i < 2; ++i)
+		byColor[i] = 0;
+	for (int i = 0; i < 7; ++i)
+		byType[i] = 0;
+
+	for (int i = BOARD_SPACES - 1; i >= 0; --i) {
+		Piece p = pieces[i];
+		if (p != PIECE_EMPTY) {
+			byColor[p < 0] |= 1ULL << i;
+			byType[p < 0 ? -p : p] |= 1ULL << i;
+		}
+	}
+
+	hash = computeHash();
+	material = computeScore();
+	tapered = computeTapered();
+	phase = computePhase();
+	if (nnueNetwork)
+		nnueRefresh(accumulator, *nnueNetwork, pieces);
+}
+
+uint64_t Board::computeHash() const {
+	uint64_t hash = 0;
+	for (int i = BOARD_SPACES - 1; i >= 0; --i)
+		hash ^= zobristPiece(pieces[i], i);
+	hash ^= zobrist.castling[castling];
+	if (enPassant >= 0)
+		hash ^= zobrist.enPassant[enPassant % BOARD_DIM];
+	return hash;
 }
 
-Score Board::getScore() {
+Score Board::computeScore() const {
 	int score = 0;
 	for (int i = BOARD_SPACES - 1; i >= 0; --i) {
 		if (pieces[i] < 0)
@@ -46,6 +84,20 @@ Score Board::getScore() {
 	return score;
 }
 
+TaperedScore Board::computeTapered() const {
+	TaperedScore score = 0;
+	for (int i = BOARD_SPACES - 1; i >= 0; --i)
+		score += pieceSquareTables.score[pieces[i] + PIECE_QUEEN][i];
+	return score;
+}
+
+int Board::computePhase() const {
+	int phase = 0;
+	for (int i = BOARD_SPACES - 1; i >= 0; --i)
+		phase += pieceSquareTables.phase[pieces[i] + PIECE_QUEEN];
+	return phase;
+}
+
 void Board::print() const {
 	auto& ss = std::cout;
 	ss << termcolor::reset << " " << termcolor::grey << termcolor::on_white;
@@ -83,232 +135,539 @@ void Board::print() const {
 
 
 /*
-	move list generation which is heavily templated!
+	move list generation from the bitboards
+	every target square in a set becomes a move from the same square
 */
+template<class STORE>
+inline void putMoves(Board* board, int from, Bitboard targets, STORE& store) {
+	while (targets)
+		store.put(Move(from, bitboardPop(targets)));
+}
 
-// move validity checks
-enum MOVE_VALIDITY {
-	ADD, STOP, ADD_STOP
-};
-struct OnlyIfEmpty {
-	//inline bool operator() (const Player player, const Piece piece) {
-	//	return piece == 0;
-	//}
-	static inline MOVE_VALIDITY shouldAdd(const Player player, const Piece piece) {
-		return piece == 0 ? ADD : STOP;
-	}
-};
-struct OnlyIfEmptyOrCapture {
-	static inline MOVE_VALIDITY shouldAdd(const Player player, const Piece piece) {
-		if (piece == 0)
-			return ADD;
-		else if (piece * player < 0)
-			return ADD_STOP;
-		else
-			return STOP;
-	}
-};
-struct OnlyIfCapture {
-	static inline MOVE_VALIDITY shouldAdd(const Player player, const Piece piece) {
-		if (piece * player < 0)
-			return ADD_STOP;
-		else
-			return STOP;
-	}
-};
-
-template<int upper>
-struct UpperBoundCheck {
-	inline bool operator() (const int val) {
-		return val < upper;
-	};
+namespace {
 
-	typedef UpperBoundCheck<upper> type;
+/*
+	what every legal move in a position has to respect, worked out once per
+	position rather than once per move
+*/
+struct LegalityInfo {
+	int king;
+	Bitboard own;
+	Bitboard enemies;
+	Bitboard checkers;
+	Bitboard pinned;   // own pieces that would uncover the king if they left its line
+	Bitboard evasions; // where anything but the king has to move while in check, everywhere otherwise
 };
-template<int lower>
-struct LowerBoundCheck {
-	inline bool operator() (const int val) {
-		return val >= lower;
-	}
 
-	typedef LowerBoundCheck<lower> type;
-};
-struct NoBoundCheck {
-	inline bool operator() (const int val) {
-		return true;
+inline LegalityInfo getLegalityInfo(const Board* board, Player player) {
+	LegalityInfo info;
+	const Bitboard occupied = board->getOccupied();
+	info.own = board->byColor[player < 0];
+	info.enemies = board->byColor[player > 0];
+	info.king = board->getKing(player);
+	info.checkers = board->getAttackersTo(info.king, occupied) & info.enemies;
+
+	// an enemy slider with exactly one piece between it and the king pins that piece
+	info.pinned = 0;
+	Bitboard snipers = ((rookAttacks(info.king, 0) & (board->byType[PIECE_ROOK] | board->byType[PIECE_QUEEN]))
+		| (bishopAttacks(info.king, 0) & (board->byType[PIECE_BISHOP] | board->byType[PIECE_QUEEN]))) & info.enemies;
+	while (snipers) {
+		Bitboard blockers = bitboardBetween(info.king, bitboardPop(snipers)) & occupied;
+		if (blockers && !(blockers & (blockers - 1)))
+			info.pinned |= blockers & info.own;
 	}
 
-	typedef NoBoundCheck type;
-};
-
+	if (!info.checkers)
+		info.evasions = ~0ULL;
+	else if (info.checkers & (info.checkers - 1))
+		info.evasions = 0; // double check, only the king can move
+	else
+		info.evasions = bitboardBetween(info.king, bitboardFirst(info.checkers)) | info.checkers;
+	return info;
+}
 
 /*
-	move to a position with an offset!
+	the squares the piece on from can legally move to, leaving out castling
+	and en passant which have rules of their own
 */
-template<class STORE, int dx, int dy, class CanMoveTo>
-bool moveTo(Board* board, Player player, int x, int y, STORE& store) {
-	typename std::conditional < (dx > 0), UpperBoundCheck<BOARD_DIM>::type, LowerBoundCheck<0>::type >::type xCheck;
-	typename std::conditional < (dy > 0), UpperBoundCheck<BOARD_DIM>::type, LowerBoundCheck<0>::type >::type yCheck;
+inline Bitboard getTargets(const Board* board, Player player, const LegalityInfo& info, int from, Piece type) {
+	const Bitboard occupied = board->getOccupied();
+	Bitboard targets;
+	switch (type) {
+		case PIECE_PAWN: {
+			const int forward = player > 0 ? BOARD_DIM : -BOARD_DIM;
+			const int startRank = player > 0 ? 1 : 6;
+			const int to = from + forward;
+			targets = stepAttacks.pawn[player < 0][from] & info.enemies;
+			if (to >= 0 && to < BOARD_SPACES && !(occupied & (1ULL << to))) {
+				targets |= 1ULL << to;
+				if (Board::indexToY(from) == startRank && !(occupied & (1ULL << (to + forward))))
+					targets |= 1ULL << (to + forward);
+			}
+			break;
+		}
+		case PIECE_KNIGHT:
+			targets = stepAttacks.knight[from];
+			break;
+		case PIECE_BISHOP:
+			targets = bishopAttacks(from, occupied);
+			break;
+		case PIECE_ROOK:
+			targets = rookAttacks(from, occupied);
+			break;
+		case PIECE_QUEEN:
+			targets = queenAttacks(from, occupied);
+			break;
+		case PIECE_KING: {
+			// the king can't hide behind itself from a slider, so look without it
+			Bitboard candidates = stepAttacks.king[from] & ~info.own;
+			targets = 0;
+			while (candidates) {
+				int to = bitboardPop(candidates);
+				if (!(board->getAttackersTo(to, occupied ^ (1ULL << from)) & info.enemies))
+					targets |= 1ULL << to;
+			}
+			return targets;
+		}
+		default:
+			return 0;
+	}
 
-	if (!xCheck(x + dx) || !yCheck(y + dy))
-		return false;
-	
+	targets &= ~info.own & info.evasions;
+	if (info.pinned & (1ULL << from))
+		targets &= bitboardLine(info.king, from);
+	return targets;
+}
 
-	const int from = Board::xyToIndex(x, y);
-	const int to = Board::xyToIndex(x + dx, y + dy);
+// whether the pawn on from can take en passant without uncovering its king
+inline bool isEnPassantLegal(const Board* board, const LegalityInfo& info, int from) {
+	const int to = board->enPassant;
+	const Bitboard taken = 1ULL << ((to & 7) | (from & ~7));
+	const Bitboard occupied = (board->getOccupied() ^ (1ULL << from) ^ taken) | (1ULL << to);
+	return !(board->getAttackersTo(info.king, occupied) & info.enemies & ~taken);
+}
 
-	switch (CanMoveTo::shouldAdd(player, board->pieces[to])) {
-		case MOVE_VALIDITY::ADD:
-			store.put(Move(board, from, to));
-			return true;
-		case MOVE_VALIDITY::ADD_STOP:
-			store.put(Move(board, from, to));
-			return false;
-		case MOVE_VALIDITY::STOP:
-			return false;
-	}
+template<class STORE>
+inline void putCastling(const Board* board, Player player, const LegalityInfo& info, STORE& store) {
+	if (info.checkers)
+		return;
+
+	const int rank = player > 0 ? 0 : 56;
+	const uint8_t kingSide = player > 0 ? CASTLE_WHITE_KING : CASTLE_BLACK_KING;
+	const uint8_t queenSide = player > 0 ? CASTLE_WHITE_QUEEN : CASTLE_BLACK_QUEEN;
+	const Bitboard occupied = board->getOccupied();
+	const Piece rook = player > 0 ? PIECE_ROOK : -PIECE_ROOK;
+	if (info.king != rank + 4)
+		return;
+
+	if ((board->castling & kingSide) && board->getPieceAt(rank + 7) == rook
+			&& !(occupied & (3ULL << (rank + 5)))
+			&& !(board->getAttackersTo(rank + 5, occupied) & info.enemies)
+			&& !(board->getAttackersTo(rank + 6, occupied) & info.enemies))
+		store.put(Move(rank + 4, rank + 6, Move::SPECIAL));
+
+	if ((board->castling & queenSide) && board->getPieceAt(rank) == rook
+			&& !(occupied & (7ULL << (rank + 1)))
+			&& !(board->getAttackersTo(rank + 3, occupied) & info.enemies)
+			&& !(board->getAttackersTo(rank + 2, occupied) & info.enemies))
+		store.put(Move(rank + 4, rank + 2, Move::SPECIAL));
 }
 
 /*
-	move along a vector
+	pawn moves to the last rank become one move per promotion piece, they
+	count as captures along with the real ones
 */
-template<class STORE, int dx, int dy, class CanMoveTo, int distance>
-struct _MoveAlongVector {
-	static inline void run(Board* board, Player player, int x, int y, STORE& store) {
-		if (moveTo<STORE, dx * distance, dy * distance, CanMoveTo>(board, player, x, y, store))
-			return _MoveAlongVector<STORE, dx, dy, CanMoveTo, distance + 1>::run(board, player, x, y, store);
+template<class STORE, GenerateType type>
+inline void putPawnMoves(Board* board, int from, Bitboard targets, STORE& store) {
+	const Piece promotions[4] = { PIECE_QUEEN, PIECE_ROOK, PIECE_BISHOP, PIECE_KNIGHT };
+	while (targets) {
+		int to = bitboardPop(targets);
+		if ((1ULL << to) & (BITBOARD_RANK_1 | BITBOARD_RANK_8)) {
+			if (type != GENERATE_QUIETS) {
+				for (Piece promotion : promotions)
+					store.put(Move(from, to, promotion));
+			}
+		} else if (board->getPieceAt(to) != PIECE_EMPTY ? type != GENERATE_QUIETS : type != GENERATE_CAPTURES)
+			store.put(Move(from, to));
 	}
-};
-
-template<class STORE, int dx, int dy, class CanMoveTo>
-struct _MoveAlongVector<STORE, dx, dy, CanMoveTo, 8> {
-	static inline void run(Board* board, Player player, int x, int y, STORE& store) { }
-};
+}
 
-template<class STORE, int dx, int dy, class CanMoveTo>
-void moveAlongVector(Board* board, Player player, int x, int y, STORE& store) {
-	_MoveAlongVector<STORE, dx, dy, CanMoveTo, 1>::run(board, player, x, y, store);
 }
 
-template<class STORE>
-void generateMoves(Board* board, Player player, int index, STORE& store) {
-	int x = Board::indexToX(index);
-	int y = Board::indexToY(index);
+template<class STORE, GenerateType type>
+void generateMoveList(Board* board, Player player, STORE& store) {
+	static_assert(std::is_base_of<MoveCache, STORE>::value, "typename STORE is not an instance of a MoveStore (must implement put)");
 
-	Piece p = board->getPieceAt(index) * player;
-	
-	switch (p) {
-		case PIECE_PAWN:
-
-			if (player > 0) {
-				if (moveTo<STORE, 0, 1, OnlyIfEmpty>(board, player, x, y, store)) {
-					if (y == 1) {
-						moveTo<STORE, 0, 2, OnlyIfEmpty>(board, player, x, y, store);
-					}
-				}
-				moveTo<STORE, -1,1, OnlyIfCapture>(board, player, x, y, store);
-				moveTo<STORE, 1,1, OnlyIfCapture>(board, player, x, y, store);
-			} else {
-				if (moveTo<STORE, 0, -1, OnlyIfEmpty>(board, player, x, y, store)) {
-					if (y == 6)
-						moveTo<STORE, 0, -2, OnlyIfEmpty>(board, player, x, y, store);
-				}
-				moveTo<STORE, -1,-1, OnlyIfCapture>(board, player, x, y, store);
-				moveTo<STORE, 1,-1, OnlyIfCapture>(board, player, x, y, store);
+	const LegalityInfo info = getLegalityInfo(board, player);
+	const Bitboard filter =
+		type == GENERATE_CAPTURES ? info.enemies :
+		type == GENERATE_QUIETS ? ~board->getOccupied() :
+		~0ULL;
+	Bitboard pieces;
+
+	// only the king can answer a double check
+	if (info.evasions) {
+		pieces = board->getPieces(player, PIECE_PAWN);
+		while (pieces) {
+			int from = bitboardPop(pieces);
+			putPawnMoves<STORE, type>(board, from, getTargets(board, player, info, from, PIECE_PAWN), store);
+		}
+
+		if (type != GENERATE_QUIETS && board->enPassant >= 0) {
+			pieces = stepAttacks.pawn[player > 0][board->enPassant] & board->getPieces(player, PIECE_PAWN);
+			while (pieces) {
+				int from = bitboardPop(pieces);
+				if (isEnPassantLegal(board, info, from))
+					store.put(Move(from, board->enPassant, Move::SPECIAL));
 			}
+		}
 
-			break ;
+		const Piece types[4] = { PIECE_KNIGHT, PIECE_BISHOP, PIECE_ROOK, PIECE_QUEEN };
+		for (Piece pieceType : types) {
+			pieces = board->getPieces(player, pieceType);
+			while (pieces) {
+				int from = bitboardPop(pieces);
+				putMoves(board, from, getTargets(board, player, info, from, pieceType) & filter, store);
+			}
+		}
+	}
 
-		case PIECE_BISHOP:
-			
-			moveAlongVector<STORE, -1, -1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE, -1,  1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE,  1, -1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE,  1,  1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			
-			break ;
+	putMoves(board, info.king, getTargets(board, player, info, info.king, PIECE_KING) & filter, store);
 
-		case PIECE_ROOK:
-			
-			moveAlongVector<STORE, -1,  0, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE,  1,  0, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE,  0, -1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE,  0,  1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			
-			break ;
+	if (type != GENERATE_CAPTURES)
+		putCastling(board, player, info, store);
+}
 
-		case PIECE_KNIGHT:
 
-			moveTo<STORE, 2,1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, 1,2, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			
-			moveTo<STORE, 2,-1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, 1,-2, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			
-			moveTo<STORE, -2,1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, -1,2, OnlyIfEmptyOrCapture>(board, player, x, y, store);
+template<class STORE> 
+void generateMoves(Board* board, Player player, STORE& store) {
+	generateMoveList<STORE, GENERATE_ALL>(board, player, store);
+}
 
-			moveTo<STORE, -2,-1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, -1,-2, OnlyIfEmptyOrCapture>(board, player, x, y, store);
+template<class STORE> 
+void generateCaptures(Board* board, Player player, STORE& store) {
+	generateMoveList<STORE, GENERATE_CAPTURES>(board, player, store);
+}
 
-			break ;
+template<class STORE> 
+void generateQuiets(Board* board, Player player, STORE& store) {
+	generateMoveList<STORE, GENERATE_QUIETS>(board, player, store);
+}
 
-		case PIECE_QUEEN:
-			
-			moveAlongVector<STORE, -1,  0, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE,  1,  0, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE,  0, -1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE,  0,  1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
 
-			moveAlongVector<STORE, -1, -1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE, -1,  1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE,  1, -1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveAlongVector<STORE,  1,  1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
+// specializations of the template code
+template void generateMoves<MoveList>(Board*, Player, MoveList& store);
+template void generateCaptures<MoveList>(Board*, Player, MoveList& store);
+template void generateQuiets<MoveList>(Board*, Player, MoveList& store);
 
-			break;
+/*
+	the same rules as the generator for a single move, so a move remembered
+	from another position can be tried without generating anything
+*/
+bool isLegal(const Board* board, Player player, Move move) {
+	if (move.isNull())
+		return false;
 
-		case PIECE_KING:
+	const int from = move.getFrom();
+	const int to = move.getTo();
+	const Piece piece = board->getPieceAt(from);
+	if (piece == PIECE_EMPTY || (piece > 0) != (player > 0))
+		return false;
+	const Piece type = piece < 0 ? -piece : piece;
 
-			moveTo<STORE, -1, -1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, 1, -1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, -1, 1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, 1, 1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, 0, 1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, 0, -1, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, 1, 0, OnlyIfEmptyOrCapture>(board, player, x, y, store);
-			moveTo<STORE, -1, 0, OnlyIfEmptyOrCapture>(board, player, x, y, store);
+	const LegalityInfo info = getLegalityInfo(board, player);
 
-			break ;
+	if (move.isSpecial()) {
+		if (move.getPromotion() != PIECE_EMPTY)
+			return false;
+		if (type == PIECE_KING) {
+			MoveList castling;
+			putCastling(board, player, info, castling);
+			for (int i = 0; i < castling.moveCount; ++i) {
+				if (castling.getMove(i) == move)
+					return true;
+			}
+			return false;
+		}
+		return type == PIECE_PAWN && to == board->enPassant && info.evasions
+			&& (stepAttacks.pawn[player < 0][from] & (1ULL << to))
+			&& isEnPassantLegal(board, info, from);
+	}
+
+	// pawns reaching the last rank have to promote, and nothing else can
+	const bool lastRank = ((1ULL << to) & (BITBOARD_RANK_1 | BITBOARD_RANK_8)) != 0;
+	if (type == PIECE_PAWN && lastRank) {
+		Piece promotion = move.getPromotion();
+		if (promotion != PIECE_QUEEN && promotion != PIECE_ROOK && promotion != PIECE_BISHOP && promotion != PIECE_KNIGHT)
+			return false;
+	} else if (move.getPromotion() != PIECE_EMPTY)
+		return false;
+
+	if (!info.evasions && type != PIECE_KING)
+		return false;
+	return (getTargets(board, player, info, from, type) & (1ULL << to)) != 0;
+}
+
+Bitboard getMoveTargets(const Board* board, Player player, int from) {
+	const Piece piece = board->getPieceAt(from);
+	if (piece == PIECE_EMPTY || (piece > 0) != (player > 0))
+		return 0;
+	const Piece type = piece < 0 ? -piece : piece;
+
+	const LegalityInfo info = getLegalityInfo(board, player);
+	if (!info.evasions && type != PIECE_KING)
+		return 0;
+	return getTargets(board, player, info, from, type);
+}
+
+// move class
+std::string Move::toCoordinate() const {
+	if (isNull())
+		return "0000";
+	std::string text;
+	text += (char) ('a' + Board::indexToX(getFrom()));
+	text += (char) ('1' + Board::indexToY(getFrom()));
+	text += (char) ('a' + Board::indexToX(getTo()));
+	text += (char) ('1' + Board::indexToY(getTo()));
+	if (getPromotion() != PIECE_EMPTY)
+		text += (char) (pieceGetLetter(getPromotion()) - 'A' + 'a');
+	return text;
+}
 
+bool parseMove(Board* board, Player player, const std::string& text, Move& move) {
+	MoveIterator moveIterator(board, player);
+	for (int i = 0; i < moveIterator.moveCount; ++i) {
+		if (moveIterator.getMove(i).toCoordinate() == text) {
+			move = moveIterator.getMove(i);
+			return true;
+		}
 	}
+	return false;
 }
 
+// the piece a fen letter stands for, upper case for player 1, empty if none
+static Piece pieceFromLetter(char letter) {
+	const Piece types[] = { PIECE_PAWN, PIECE_KNIGHT, PIECE_BISHOP, PIECE_ROOK, PIECE_QUEEN, PIECE_KING };
+	for (Piece type : types) {
+		if (letter == pieceGetLetter(type))
+			return type;
+		if (letter == pieceGetLetter(type) - 'A' + 'a')
+			return -type;
+	}
+	return PIECE_EMPTY;
+}
 
-template<class STORE> 
-void generateMoves(Board* board, Player player, STORE& store) {
-	static_assert(std::is_base_of<MoveCache, STORE>::value, "typename STORE is not an instance of a MoveStore (must implement put)");
+static inline const char* skipSpaces(const char* text) {
+	while (*text == ' ' || *text == '\t')
+		text++;
+	return text;
+}
 
-	for (int i = BOARD_SPACES - 1; i >= 0; --i) {
-		if (board->getPieceAt(i) * player > 0) {
-			generateMoves(board, player, i, store);
+const char* parseFen(const char* text, Board* board, Player& player) {
+	Piece pieces[BOARD_SPACES] = { };
+	text = skipSpaces(text);
+
+	// placement, from the 8th rank down
+	int x = 0, y = BOARD_DIM - 1;
+	for (; *text > ' '; ++text) {
+		if (*text == '/') {
+			if (x != BOARD_DIM || y == 0)
+				return nullptr;
+			x = 0;
+			y--;
+		} else if (*text >= '1' && *text <= '8') {
+			x += *text - '0';
+			if (x > BOARD_DIM)
+				return nullptr;
+		} else {
+			const Piece piece = pieceFromLetter(*text);
+			if (piece == PIECE_EMPTY || x >= BOARD_DIM)
+				return nullptr;
+			pieces[Board::xyToIndex(x++, y)] = piece;
+		}
+	}
+	if (x != BOARD_DIM || y != 0)
+		return nullptr;
+
+	int kings[2] = { 0, 0 };
+	for (int i = 0; i < BOARD_SPACES; ++i) {
+		if (pieces[i] == PIECE_KING || pieces[i] == -PIECE_KING)
+			kings[pieces[i] < 0]++;
+		if ((pieces[i] == PIECE_PAWN || pieces[i] == -PIECE_PAWN) && (i < BOARD_DIM || i >= BOARD_SPACES - BOARD_DIM))
+			return nullptr;
+	}
+	if (kings[0] != 1 || kings[1] != 1)
+		return nullptr;
+
+	text = skipSpaces(text);
+	if (*text != 'w' && *text != 'b')
+		return nullptr;
+	const Player toMove = *text++ == 'w' ? 1 : -1;
+
+	// rights whose king or rook isn't at home are dropped, some fens list them anyway
+	text = skipSpaces(text);
+	uint8_t castling = 0;
+	if (*text == '-') {
+		text++;
+	} else {
+		for (; *text > ' '; ++text) {
+			switch (*text) {
+				case 'K':
+					castling |= pieces[4] == PIECE_KING && pieces[7] == PIECE_ROOK ? CASTLE_WHITE_KING : 0;
+					break;
+				case 'Q':
+					castling |= pieces[4] == PIECE_KING && pieces[0] == PIECE_ROOK ? CASTLE_WHITE_QUEEN : 0;
+					break;
+				case 'k':
+					castling |= pieces[60] == -PIECE_KING && pieces[63] == -PIECE_ROOK ? CASTLE_BLACK_KING : 0;
+					break;
+				case 'q':
+					castling |= pieces[60] == -PIECE_KING && pieces[56] == -PIECE_ROOK ? CASTLE_BLACK_QUEEN : 0;
+					break;
+				default:
+					return nullptr;
+			}
 		}
 	}
+
+	text = skipSpaces(text);
+	int enPassant = -1;
+	if (*text == '-') {
+		text++;
+	} else if (text[0] >= 'a' && text[0] <= 'h' && (text[1] == (toMove > 0 ? '6' : '3'))) {
+		// like castling, dropped unless the pawn that just moved is there
+		enPassant = Board::xyToIndex(text[0] - 'a', text[1] - '1');
+		if (pieces[enPassant] != PIECE_EMPTY || pieces[enPassant - BOARD_DIM * toMove] != -toMove * PIECE_PAWN)
+			enPassant = -1;
+		text += 2;
+	} else {
+		return nullptr;
+	}
+
+	// the move counters are optional, epd leaves them out
+	for (int counter = 0; counter < 2; ++counter) {
+		const char* number = skipSpaces(text);
+		if (*number < '0' || *number > '9')
+			break;
+		while (*number >= '0' && *number <= '9')
+			number++;
+		text = number;
+	}
+
+	Board parsed;
+	for (int i = 0; i < BOARD_SPACES; ++i)
+		parsed.pieces[i] = pieces[i];
+	parsed.castling = castling;
+	parsed.enPassant = (int8_t) enPassant;
+	parsed.synchronize();
+
+	// the side to move could take the king
+	if (parsed.isInCheck(-toMove))
+		return nullptr;
+
+	*board = parsed;
+	player = toMove;
+	return text;
 }
 
+std::string toFen(const Board* board, Player player, int halfmoves, int fullmoves) {
+	std::string fen;
+	for (int y = BOARD_DIM - 1; y >= 0; --y) {
+		int empty = 0;
+		for (int x = 0; x < BOARD_DIM; ++x) {
+			const Piece piece = board->getPieceAt(Board::xyToIndex(x, y));
+			if (piece == PIECE_EMPTY) {
+				empty++;
+				continue;
+			}
+			if (empty)
+				fen += (char) ('0' + empty);
+			empty = 0;
+			const char letter = pieceGetLetter(piece < 0 ? -piece : piece);
+			fen += piece < 0 ? (char) (letter - 'A' + 'a') : letter;
+		}
+		if (empty)
+			fen += (char) ('0' + empty);
+		if (y)
+			fen += '/';
+	}
 
-// specializations of the template code
-template void generateMoves<MoveIterator>(Board*, Player, MoveIterator& store);
+	fen += player > 0 ? " w " : " b ";
+	if (board->castling & CASTLE_WHITE_KING)
+		fen += 'K';
+	if (board->castling & CASTLE_WHITE_QUEEN)
+		fen += 'Q';
+	if (board->castling & CASTLE_BLACK_KING)
+		fen += 'k';
+	if (board->castling & CASTLE_BLACK_QUEEN)
+		fen += 'q';
+	if (!board->castling)
+		fen += '-';
+
+	fen += ' ';
+	if (board->enPassant >= 0) {
+		fen += (char) ('a' + Board::indexToX((int) board->enPassant));
+		fen += (char) ('1' + Board::indexToY((int) board->enPassant));
+	} else {
+		fen += '-';
+	}
+	return fen + " " + std::to_string(halfmoves) + " " + std::to_string(fullmoves);
+}
 
+std::string moveToSan(Board* board, Player player, Move move) {
+	const int from = move.getFrom();
+	const int to = move.getTo();
+	const Piece piece = board->getPieceAt(from);
+	const Piece type = piece < 0 ? -piece : piece;
+
+	std::string text;
+	if (type == PIECE_KING && move.isSpecial()) {
+		text = to > from ? "O-O" : "O-O-O";
+	} else {
+		const std::string squares = move.toCoordinate();
+		// pawns capture, en passant included, whenever they change file
+		const bool capture = type == PIECE_PAWN ? Board::indexToX(from) != Board::indexToX(to) : move.isCapture(board);
+		if (type == PIECE_PAWN) {
+			if (capture)
+				text += squares[0];
+		} else {
+			text += pieceGetLetter(type);
+
+			// name the file, the rank or both when another piece like it can reach the same square
+			bool ambiguous = false, sameFile = false, sameRank = false;
+			MoveIterator moves(board, player);
+			for (int i = 0; i < moves.moveCount; ++i) {
+				const Move other = moves.getMove(i);
+				if (other.getTo() != to || other.getFrom() == from || board->getPieceAt(other.getFrom()) != piece)
+					continue;
+				ambiguous = true;
+				sameFile |= Board::indexToX(other.getFrom()) == Board::indexToX(from);
+				sameRank |= Board::indexToY(other.getFrom()) == Board::indexToY(from);
+			}
+			if (ambiguous && !sameFile)
+				text += squares[0];
+			else if (ambiguous && !sameRank)
+				text += squares[1];
+			else if (ambiguous)
+				text += squares.substr(0, 2);
+		}
+		if (capture)
+			text += 'x';
+		text += squares.substr(2, 2);
+		if (move.getPromotion() != PIECE_EMPTY) {
+			text += '=';
+			text += pieceGetLetter(move.getPromotion());
+		}
+	}
 
-// move class
-std::string Move::toString() {
-	std::stringstream ss;
-	ss << "(";
-	for (int i = 0; i < sizeof(changes) / sizeof(PiecePosPair); ++i) {
-		ss << "[" << (int) (changes[i].index) << ":" << (int) (changes[i].piece) << "],";
+	Move::Undo undo;
+	move.apply(board, undo);
+	if (board->isInCheck(-player)) {
+		MoveIterator replies(board, -player);
+		text += replies.moveCount == 0 ? '#' : '+';
 	}
-	ss << ")";
-	return ss.str();
+	move.revert(board, undo);
+	return text;
 }
 	
-};
\ No newline at end of file
+};
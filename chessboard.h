@@ -4,6 +4,9 @@
 #include <stdint.h>
 #include <string>
 #include <cassert>
+#include "bitboard.h"
+#include "evaluation.h"
+#include "nnue.h"
 
 namespace chess {
 
@@ -24,6 +27,13 @@ const Piece PIECE_ROOK = 4;
 const Piece PIECE_KING = 5;
 const Piece PIECE_QUEEN = 6;
 
+// castling rights, one bit for each side of each player
+const uint8_t CASTLE_WHITE_KING = 1;
+const uint8_t CASTLE_WHITE_QUEEN = 2;
+const uint8_t CASTLE_BLACK_KING = 4;
+const uint8_t CASTLE_BLACK_QUEEN = 8;
+const uint8_t CASTLE_ALL = 15;
+
 /*
 	get piece values
 */
@@ -48,6 +58,57 @@ inline int pieceGetValue(Piece piece) {
 	}
 }
 
+/*
+	piece values with the sign of the piece, so a sum over the board is the
+	material balance from player 1's point of view
+*/
+inline int pieceGetSignedValue(Piece piece) {
+	return piece < 0 ? -pieceGetValue(-piece) : pieceGetValue(piece);
+}
+
+/*
+	zobrist keys
+	one random key per (piece, square) plus one for the player to move,
+	each set of castling rights and each en passant file,
+	generated at compile time so they are ready before any board is built
+*/
+struct ZobristKeys {
+	uint64_t pieces[13][BOARD_SPACES]; // indexed by piece + PIECE_QUEEN, empty squares are 0
+	uint64_t side; // xor'd in when the second player (-1) is to move
+	uint64_t castling[16]; // indexed by the CASTLE_ flags, no rights is 0
+	uint64_t enPassant[BOARD_DIM]; // by file of the en passant square
+};
+
+constexpr uint64_t zobristNext(uint64_t& state) {
+	// splitmix64
+	state += 0x9e3779b97f4a7c15ULL;
+	uint64_t z = state;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys zobristGenerate() {
+	ZobristKeys keys = {};
+	uint64_t state = 0x4368657373426f61ULL;
+	for (int piece = 0; piece < 13; ++piece) {
+		for (int i = 0; i < BOARD_SPACES; ++i)
+			keys.pieces[piece][i] = piece == PIECE_QUEEN ? 0 : zobristNext(state);
+	}
+	keys.side = zobristNext(state);
+	for (int i = 1; i < 16; ++i)
+		keys.castling[i] = zobristNext(state);
+	for (int i = 0; i < BOARD_DIM; ++i)
+		keys.enPassant[i] = zobristNext(state);
+	return keys;
+}
+
+extern const ZobristKeys zobrist;
+
+inline uint64_t zobristPiece(Piece piece, int index) {
+	return zobrist.pieces[piece + PIECE_QUEEN][index];
+}
+
 /*
 	get piece letters, also very fast
 */
@@ -75,34 +136,74 @@ inline char pieceGetLetter(Piece piece) {
 	}
 }
 
+const int MAX_MOVES = 256; // longest move list the generator can produce
+
 /*
 	Move
-	stores a single move in the game
-	has room for 4 positions to change their pieces
+	a single move packed into 16 bits
+		bits  0-5  from square
+		bits  6-11 to square
+		bits 12-14 piece type a pawn promotes to, PIECE_EMPTY otherwise
+		bit  15    castling or en passant, told apart by the piece that moves
+	castling is written as the king's move, the rook follows it.
+	0 is the null move since nothing moves from a1 to a1.
 	usage:
-		- call apply once to apply it
-		- call apply again to revert back to original state
-		- be aware apply modifies the move!
+		- call apply with an Undo to make the move
+		- call revert with the same Undo to take it back
 */
 struct Board;
 struct Move {
-	struct PiecePosPair {
-		Position index;
-		Piece piece;
+	// what apply overwrites, so revert can put it back
+	struct Undo {
+		Piece captured; // the piece on the target square, empty for en passant
+		uint8_t castling;
+		int8_t enPassant;
 	};
-	PiecePosPair changes[4]; // up to 4 changes can be made
 
-	Move();
-	Move(const Board* board, Position p1, Position p2);
+	static const uint16_t SPECIAL = 1 << 15;
+
+	uint16_t data;
+
+	inline Move() : data(0) { }
+	inline explicit Move(uint16_t data) : data(data) { }
+	inline Move(Position from, Position to, Piece promotion = PIECE_EMPTY) : data((uint16_t) (from | (to << 6) | (promotion << 12))) { }
+	inline Move(Position from, Position to, uint16_t flags) : data((uint16_t) (from | (to << 6) | flags)) { }
+
+	inline int getFrom() const { return data & 0x3f; }
+	inline int getTo() const { return (data >> 6) & 0x3f; }
+	inline Piece getPromotion() const { return (Piece) ((data >> 12) & 0x7); }
+	inline bool isSpecial() const { return (data & SPECIAL) != 0; }
+
+	// the transposition table form is the move itself
+	inline uint16_t pack() const {
+		return data;
+	}
+	static inline Move unpack(const Board* board, uint16_t packed) {
+		return Move(packed);
+	}
+
+	// only meaningful while the move is not applied
+	inline bool isCapture(const Board* board) const;
+	// captures and promotions, everything quiescence search looks at
+	inline bool isNoisy(const Board* board) const;
+	inline int getCaptureScore(const Board* board) const;
+
+	inline void apply(Board* board, Undo& undo) const;
+	inline void revert(Board* board, const Undo& undo) const;
 
-	void apply(Board* board);
-	Score score(Board* board);
+	// pass the turn, which only gives up the right to take en passant
+	static inline void applyNull(Board* board, Undo& undo);
+	static inline void revertNull(Board* board, const Undo& undo);
 
-	inline bool isNull() {
-		return changes[0].index == -1;
+	inline bool isNull() const {
+		return data == 0;
 	}
 
-	std::string toString();
+	inline bool operator==(const Move& other) const {
+		return data == other.data;
+	}
+
+	std::string toCoordinate() const; // e.g. "e2e4", "e7e8q"
 };
 
 
@@ -113,6 +214,18 @@ struct Move {
 */
 struct Board {
 	Piece pieces[64];
+	uint64_t hash; // zobrist hash of pieces, castling and en passant, maintained by the setters
+	Score material; // sum of pieceGetSignedValue over the board, maintained by setPieceAt
+	TaperedScore tapered; // sum of the piece-square scores, maintained by setPieceAt
+	int phase; // sum of the piece phases, PHASE_MAX at the start, maintained by setPieceAt
+	uint8_t castling; // CASTLE_ flags of the rights still held
+	int8_t enPassant; // square behind a pawn that just moved two, -1 for none
+
+	NnueAccumulator accumulator; // first layer of the loaded network, maintained by setPieceAt while there is one
+
+	// the same position as bitboards, maintained by setPieceAt
+	Bitboard byColor[2]; // 0 for positive (player 1) pieces, 1 for negative
+	Bitboard byType[7];  // indexed by piece type, byType[PIECE_EMPTY] is unused
 
 	Board();
 	~Board() {};
@@ -122,10 +235,102 @@ struct Board {
 	}
 
 	inline void setPieceAt(int index, Piece piece) {
+		const Bitboard bit = 1ULL << index;
+		const Piece old = pieces[index];
+		if (old != PIECE_EMPTY) {
+			byColor[old < 0] ^= bit;
+			byType[old < 0 ? -old : old] ^= bit;
+		}
+		if (piece != PIECE_EMPTY) {
+			byColor[piece < 0] ^= bit;
+			byType[piece < 0 ? -piece : piece] ^= bit;
+		}
+
+		hash ^= zobristPiece(old, index) ^ zobristPiece(piece, index);
+		material += pieceGetSignedValue(piece) - pieceGetSignedValue(old);
+		tapered += pieceSquareTables.score[piece + PIECE_QUEEN][index] - pieceSquareTables.score[old + PIECE_QUEEN][index];
+		phase += pieceSquareTables.phase[piece + PIECE_QUEEN] - pieceSquareTables.phase[old + PIECE_QUEEN];
+		if (nnueNetwork) {
+			if (old != PIECE_EMPTY)
+				nnueRemovePiece(accumulator, *nnueNetwork, old, index);
+			if (piece != PIECE_EMPTY)
+				nnueAddPiece(accumulator, *nnueNetwork, piece, index);
+		}
 		pieces[index] = piece;
 	}
 
-	Score getScore();
+	inline void setCastling(uint8_t rights) {
+		hash ^= zobrist.castling[castling] ^ zobrist.castling[rights];
+		castling = rights;
+	}
+
+	inline void setEnPassant(int square) {
+		if (enPassant >= 0)
+			hash ^= zobrist.enPassant[enPassant % BOARD_DIM];
+		if (square >= 0)
+			hash ^= zobrist.enPassant[square % BOARD_DIM];
+		enPassant = (int8_t) square;
+	}
+
+	inline Bitboard getOccupied() const {
+		return byColor[0] | byColor[1];
+	}
+
+	// pieces of a type belonging to player
+	inline Bitboard getPieces(Player player, Piece type) const {
+		return byType[type] & byColor[player < 0];
+	}
+
+	inline int getKing(Player player) const {
+		return bitboardFirst(getPieces(player, PIECE_KING));
+	}
+
+	// pieces of either colour attacking index, as if the occupied squares were occupied
+	inline Bitboard getAttackersTo(int index, Bitboard occupied) const {
+		return (stepAttacks.pawn[1][index] & byType[PIECE_PAWN] & byColor[0])
+			| (stepAttacks.pawn[0][index] & byType[PIECE_PAWN] & byColor[1])
+			| (stepAttacks.knight[index] & byType[PIECE_KNIGHT])
+			| (stepAttacks.king[index] & byType[PIECE_KING])
+			| (bishopAttacks(index, occupied) & (byType[PIECE_BISHOP] | byType[PIECE_QUEEN]))
+			| (rookAttacks(index, occupied) & (byType[PIECE_ROOK] | byType[PIECE_QUEEN]));
+	}
+
+	inline bool isInCheck(Player player) const {
+		return (getAttackersTo(getKing(player), getOccupied()) & byColor[player > 0]) != 0;
+	}
+
+	inline uint64_t getHash() const {
+		return hash;
+	}
+
+	uint64_t computeHash() const;
+
+	// recomputes the hash, scores and bitboards after pieces[] was written directly
+	void synchronize();
+
+	// material balance from player 1's point of view
+	inline Score getScore() const {
+		return material;
+	}
+
+	Score computeScore() const;
+
+	/*
+		piece-square score in centipawns from player 1's point of view, blended
+		from the midgame score to the endgame one as pieces come off the board
+	*/
+	inline Score getTaperedScore() const {
+		const int midgamePhase = phase < PHASE_MAX ? phase : PHASE_MAX; // promotions can push it past
+		return (taperedMidgame(tapered) * midgamePhase + taperedEndgame(tapered) * (PHASE_MAX - midgamePhase)) / PHASE_MAX;
+	}
+
+	TaperedScore computeTapered() const;
+	int computePhase() const;
+
+	// centipawns for player from the loaded network, there must be one
+	inline Score getNetworkScore(Player player) const {
+		return nnueEvaluate(accumulator, *nnueNetwork, player < 0);
+	}
 
 	template<typename T>
 	static inline T indexToX(T index) { return index % BOARD_DIM; };
@@ -137,67 +342,208 @@ struct Board {
 	void print() const;
 };
 
+enum GenerateType {
+	GENERATE_ALL,
+	GENERATE_CAPTURES, // only the moves that take a piece
+	GENERATE_QUIETS    // only the moves that don't
+};
+
 template<class STORE> 
 void generateMoves(Board* board, Player player, STORE& store);
 
+template<class STORE> 
+void generateCaptures(Board* board, Player player, STORE& store);
+
+template<class STORE> 
+void generateQuiets(Board* board, Player player, STORE& store);
+
+// true if the generator would produce move for player
+bool isLegal(const Board* board, Player player, Move move);
+
+/*
+	the squares the piece on from can legally move to, leaving out castling
+	and en passant, empty when it isn't one of player's pieces
+*/
+Bitboard getMoveTargets(const Board* board, Player player, int from);
+
 struct MoveCache { };
 
-struct MoveIterator : public MoveCache {
+/*
+	finds the move written in coordinate notation ("e2e4") among the moves
+	player can make, false if there is no such move
+*/
+bool parseMove(Board* board, Player player, const std::string& text, Move& move);
+
+/*
+	reads the first four fields of a fen (placement, side to move, castling,
+	en passant) into board and player, and the move counters after them when
+	they are there, which the board doesn't keep. fields end at any
+	whitespace, so it reads straight out of a line of a larger text. returns
+	where it stopped, so the operations of an epd line follow, or null if
+	the text isn't a valid position (one king each, no pawns on the back
+	ranks, the side not to move not in check), leaving board as it was.
+*/
+const char* parseFen(const char* text, Board* board, Player& player);
+
+// the position as a fen, with the given move counters
+std::string toFen(const Board* board, Player player, int halfmoves = 0, int fullmoves = 1);
+
+/*
+	the move in standard algebraic notation ("Nbd7", "exd5", "O-O", "e8=Q#"),
+	player has to be able to make it
+*/
+std::string moveToSan(Board* board, Player player, Move move);
+
+/*
+	a move with room for a sort key, left raw so a move list costs nothing
+	to construct
+*/
+struct ScoredMove {
+	uint16_t move;
+	int16_t score;
+};
+
+/*
+	MoveList
+	a store the generators can fill, empty until they are called
+*/
+struct MoveList : public MoveCache {
 	int moveCount;
-	Move moves[128];
+	ScoredMove moves[MAX_MOVES];
 
-	MoveIterator(Board* board, Player player) : moveCount(0) {
-		generateMoves<MoveIterator>(board, player, *this);
-	}
+	MoveList() : moveCount(0) { }
 
-	inline bool getNext(Move& move) {
-		if (moveCount == 0) {
-			move = moves[--moveCount];	
-			return false;
-		}
-		else {
-			move = moves[--moveCount];
-			return true;
-		}
+	inline Move getMove(int index) const {
+		return Move(moves[index].move);
 	}
 
 	inline void put(const Move move) {
-		moves[moveCount++] = move;
+		moves[moveCount++].move = move.data;
+	}
+};
+
+struct MoveIterator : public MoveList {
+	MoveIterator(Board* board, Player player, bool capturesOnly = false) {
+		if (capturesOnly)
+			generateCaptures<MoveList>(board, player, *this);
+		else
+			generateMoves<MoveList>(board, player, *this);
+	}
+
+	inline bool getNext(Move& move) {
+		if (moveCount == 0)
+			return false;
+		move = Move(moves[--moveCount].move);
+		return true;
 	}
 };
 
 /*
 	move inline implementations
 */
-inline Move::Move() {
-	changes[0].index = -1;
+inline bool Move::isCapture(const Board* board) const {
+	if (isSpecial()) {
+		Piece piece = board->getPieceAt(getFrom());
+		return piece == PIECE_PAWN || piece == -PIECE_PAWN;
+	}
+	return board->getPieceAt(getTo()) != PIECE_EMPTY;
+}
+
+inline bool Move::isNoisy(const Board* board) const {
+	return getPromotion() != PIECE_EMPTY || isCapture(board);
+}
+
+/*
+	most valuable victim / least valuable attacker, higher is better
+	values are capped below 16 so the victim always dominates, promotions
+	count the piece gained as well
+*/
+inline int Move::getCaptureScore(const Board* board) const {
+	Piece victim = isSpecial() ? PIECE_PAWN : board->getPieceAt(getTo());
+	Piece attacker = board->getPieceAt(getFrom());
+	int victimValue = pieceGetValue(victim < 0 ? -victim : victim) + pieceGetValue(getPromotion());
+	int attackerValue = pieceGetValue(attacker < 0 ? -attacker : attacker);
+	return (victimValue < 15 ? victimValue : 15) * 16 - (attackerValue < 15 ? attackerValue : 15);
+}
+
+// castling rights that survive a move touching index
+constexpr uint8_t castlingKeptByIndex(int index) {
+	return index == 0 ? CASTLE_ALL & ~CASTLE_WHITE_QUEEN :
+		index == 7 ? CASTLE_ALL & ~CASTLE_WHITE_KING :
+		index == 4 ? CASTLE_ALL & ~(CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN) :
+		index == 56 ? CASTLE_ALL & ~CASTLE_BLACK_QUEEN :
+		index == 63 ? CASTLE_ALL & ~CASTLE_BLACK_KING :
+		index == 60 ? CASTLE_ALL & ~(CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN) :
+		CASTLE_ALL;
 }
 
-inline Move::Move(const Board* board, Position p1, Position p2) {
-	changes[0].index = p1;
-	changes[0].piece = PIECE_EMPTY;
-	changes[1].index = p2;
-	changes[1].piece = board->getPieceAt(p1);
-	changes[2].index = -1;
+inline void Move::apply(Board* board, Undo& undo) const {
+	const int from = getFrom();
+	const int to = getTo();
+	Piece piece = board->getPieceAt(from);
+
+	undo.captured = board->getPieceAt(to);
+	undo.castling = board->castling;
+	undo.enPassant = board->enPassant;
+
+	if (isSpecial()) {
+		if (piece == PIECE_KING || piece == -PIECE_KING) {
+			// castling, the rook jumps over the king
+			int rookFrom = to > from ? from + 3 : from - 4;
+			int rookTo = to > from ? from + 1 : from - 1;
+			board->setPieceAt(rookTo, board->getPieceAt(rookFrom));
+			board->setPieceAt(rookFrom, PIECE_EMPTY);
+		} else {
+			// en passant, the pawn taken is beside the one taking it
+			board->setPieceAt((to & 7) | (from & ~7), PIECE_EMPTY);
+		}
+	}
+
+	board->setEnPassant(-1);
+	if ((piece == PIECE_PAWN || piece == -PIECE_PAWN) && (to - from == 16 || from - to == 16))
+		board->setEnPassant((from + to) / 2);
+	if (board->castling)
+		board->setCastling(board->castling & castlingKeptByIndex(from) & castlingKeptByIndex(to));
+
+	if (getPromotion() != PIECE_EMPTY)
+		piece = piece < 0 ? -getPromotion() : getPromotion();
+	board->setPieceAt(from, PIECE_EMPTY);
+	board->setPieceAt(to, piece);
 }
 
-inline void Move::apply(Board* board) {
-	for (int i = 0; i < sizeof(changes) / sizeof(PiecePosPair); ++i) {
-		if (changes[i].index < 0)
-			break;
-		Piece old = board->getPieceAt(changes[i].index);
-		board->setPieceAt(changes[i].index, changes[i].piece);
-		changes[i].piece = old;
+inline void Move::revert(Board* board, const Undo& undo) const {
+	const int from = getFrom();
+	const int to = getTo();
+	Piece piece = board->getPieceAt(to);
+	if (getPromotion() != PIECE_EMPTY)
+		piece = piece < 0 ? -PIECE_PAWN : PIECE_PAWN;
+
+	board->setPieceAt(from, piece);
+	board->setPieceAt(to, undo.captured);
+
+	if (isSpecial()) {
+		if (piece == PIECE_KING || piece == -PIECE_KING) {
+			int rookFrom = to > from ? from + 3 : from - 4;
+			int rookTo = to > from ? from + 1 : from - 1;
+			board->setPieceAt(rookFrom, board->getPieceAt(rookTo));
+			board->setPieceAt(rookTo, PIECE_EMPTY);
+		} else {
+			board->setPieceAt((to & 7) | (from & ~7), -piece);
+		}
 	}
+
+	board->setCastling(undo.castling);
+	board->setEnPassant(undo.enPassant);
 }
 
-inline Score Move::score(Board* board) {
-	apply(board);
-	Score score = board->getScore();
-	apply(board);
-	return score;
+inline void Move::applyNull(Board* board, Undo& undo) {
+	undo.enPassant = board->enPassant;
+	board->setEnPassant(-1);
 }
 
+inline void Move::revertNull(Board* board, const Undo& undo) {
+	board->setEnPassant(undo.enPassant);
+}
 
 
 }
@@ -0,0 +1,235 @@
+#ifndef __CHESSGAME_H_
+#define __CHESSGAME_H_
+
+#include <climits>
+#include <type_traits>
+#include "chessboard.h"
+#include "tablebase.h"
+#include "minimax.h"
+
+/*
+	the chess side of the abstract game: the player, heuristics and move
+	iterator the searches are instantiated with, shared by the self-play
+	program and the uci engine
+*/
+
+// basically just an integer but abstracted a bit
+struct ChessPlayer {
+	chess::Player player;
+
+	inline ChessPlayer(chess::Player player) : player(player) {
+		
+	}
+
+	inline ChessPlayer getOpponent() {
+		return ChessPlayer(-player);
+	}
+
+	inline uint64_t getHash() const {
+		return player > 0 ? 0 : chess::zobrist.side;
+	}
+
+	inline int getIndex() const {
+		return player > 0 ? 0 : 1;
+	}
+};
+
+template<int capture_threshold>
+struct ChessHeuristic {
+	static const int SCORE_MATE = 100000; // above any material balance
+
+	inline static int getScore(chess::Board* board, ChessPlayer player) {
+		return board->getScore() * player.player;
+	}
+
+	// mated, sooner is worse, or stalemated
+	inline static int getTerminalScore(chess::Board* board, ChessPlayer player, int ply) {
+		return board->isInCheck(player.player) ? -SCORE_MATE + ply : 0;
+	}
+
+	static const int FUTILITY_MARGIN = 2;
+
+	inline static bool isInCheck(chess::Board* board, ChessPlayer player) {
+		return board->isInCheck(player.player);
+	}
+
+	// with only pawns left zugzwang is common enough that passing can't be trusted
+	inline static bool allowNullMove(chess::Board* board, ChessPlayer player) {
+		const chess::Bitboard pawnsAndKings = board->byType[chess::PIECE_PAWN] | board->byType[chess::PIECE_KING];
+		return (board->byColor[player.player < 0] & ~pawnsAndKings) != 0;
+	}
+
+	// won and lost positions score like the mates they lead to
+	inline static bool probeTablebase(chess::Board* board, ChessPlayer player, int ply, int& score) {
+		chess::TablebaseResult result;
+		if (!chess::tablebases.probe(board, player.player, result))
+			return false;
+		score = result.result == 0 ? 0 : result.result > 0 ? SCORE_MATE - ply - result.plies : -SCORE_MATE + ply + result.plies;
+		return true;
+	}
+
+	// at least capture_threshold pieces came off the board since boardA
+	inline static bool shouldSearchDeeper(chess::Board* boardA, chess::Board* boardB) {
+		return chess::bitboardCount(boardA->getOccupied()) - chess::bitboardCount(boardB->getOccupied()) >= capture_threshold;
+	}
+};
+
+/*
+	ChessHeuristic scoring positions from the piece-square tables, in centipawns,
+	rather than by material alone. the tables are kept up to date by the board
+	as moves are made so a score costs no more than the material count.
+*/
+template<int capture_threshold>
+struct ChessTaperedHeuristic : public ChessHeuristic<capture_threshold> {
+	inline static int getScore(chess::Board* board, ChessPlayer player) {
+		return board->getTaperedScore() * player.player;
+	}
+
+	static const int FUTILITY_MARGIN = 100;
+};
+
+/*
+	ChessTaperedHeuristic scored by the network loaded with -nnue instead, when
+	there is one. the board keeps its first layer up to date as moves are made.
+*/
+template<int capture_threshold>
+struct ChessNetworkHeuristic : public ChessTaperedHeuristic<capture_threshold> {
+	inline static int getScore(chess::Board* board, ChessPlayer player) {
+		if (chess::nnueNetwork)
+			return board->getNetworkScore(player.player);
+		return ChessTaperedHeuristic<capture_threshold>::getScore(board, player);
+	}
+};
+
+/*
+	hands moves back best first, generating them in stages so a node that
+	cuts off early never pays for the rest:
+		- the hash move, checked rather than generated
+		- captures and promotions by mvv-lva
+		- killer moves, also checked rather than generated
+		- quiet moves by history
+	scores live in the move list itself and have to fit in 16 bits
+*/
+struct ChessMoveIterator {
+	enum Stage {
+		STAGE_HASH,
+		STAGE_CAPTURES_GENERATE,
+		STAGE_CAPTURES,
+		STAGE_KILLERS,
+		STAGE_QUIETS_GENERATE,
+		STAGE_QUIETS,
+		STAGE_UNORDERED, // ordering is off, every move in generation order
+		STAGE_DONE
+	};
+
+	static const int SCORE_QUIET_MAX = INT16_MAX;
+	static const int HISTORY_SHIFT = 5; // history counters stay below 1 << 20
+
+	chess::Board* board;
+	ChessPlayer player;
+	minimax::OrderingHints hints;
+	Stage stage;
+	int killerIndex;
+	chess::Move killers[2]; // the ones already returned
+	chess::MoveList moveList;
+
+	inline ChessMoveIterator(chess::Board* board, ChessPlayer player, const minimax::OrderingHints& hints) : board(board), player(player), hints(hints), stage(STAGE_HASH), killerIndex(0) {
+		if (hints.ordering != nullptr && !hints.ordering->enabled) {
+			stage = STAGE_UNORDERED;
+			if (hints.noisyOnly)
+				chess::generateCaptures<chess::MoveList>(board, player.player, moveList);
+			else
+				chess::generateMoves<chess::MoveList>(board, player.player, moveList);
+		}
+	};
+
+	inline bool getNext(chess::Move& move) {
+		switch (stage) {
+			case STAGE_HASH:
+				stage = STAGE_CAPTURES_GENERATE;
+				move = chess::Move(hints.hashMove);
+				if (chess::isLegal(board, player.player, move))
+					return true;
+				// fall through
+			case STAGE_CAPTURES_GENERATE:
+				chess::generateCaptures<chess::MoveList>(board, player.player, moveList);
+				for (int i = 0; i < moveList.moveCount; ++i)
+					moveList.moves[i].score = (int16_t) moveList.getMove(i).getCaptureScore(board);
+				stage = STAGE_CAPTURES;
+				// fall through
+			case STAGE_CAPTURES:
+				while (pickBest(move)) {
+					if (move.pack() != hints.hashMove)
+						return true;
+				}
+				if (hints.noisyOnly) {
+					stage = STAGE_DONE;
+					return false;
+				}
+				stage = STAGE_KILLERS;
+				// fall through
+			case STAGE_KILLERS:
+				while (hints.ordering != nullptr && hints.ply >= 0 && killerIndex < 2) {
+					move = chess::Move(hints.ordering->killers[hints.ply][killerIndex]);
+					killers[killerIndex++] = move;
+					if (move.pack() != hints.hashMove && !(killerIndex == 2 && move == killers[0])
+							&& chess::isLegal(board, player.player, move) && !move.isNoisy(board))
+						return true;
+				}
+				stage = STAGE_QUIETS_GENERATE;
+				// fall through
+			case STAGE_QUIETS_GENERATE:
+				chess::generateQuiets<chess::MoveList>(board, player.player, moveList);
+				for (int i = 0; i < moveList.moveCount; ++i) {
+					int score = 0;
+					if (hints.ordering != nullptr) {
+						score = hints.ordering->getHistory(hints.side, moveList.moves[i].move) >> HISTORY_SHIFT;
+						if (score > SCORE_QUIET_MAX)
+							score = SCORE_QUIET_MAX;
+					}
+					moveList.moves[i].score = (int16_t) score;
+				}
+				stage = STAGE_QUIETS;
+				// fall through
+			case STAGE_QUIETS:
+				while (pickBest(move)) {
+					if (move.pack() != hints.hashMove && !(move == killers[0]) && !(move == killers[1]))
+						return true;
+				}
+				stage = STAGE_DONE;
+				return false;
+			case STAGE_UNORDERED:
+				if (moveList.moveCount == 0)
+					return false;
+				move = chess::Move(moveList.moves[--moveList.moveCount].move);
+				return true;
+			default:
+				return false;
+		}
+	};
+
+	// selection sort one move at a time, most nodes cut off after a few
+	inline bool pickBest(chess::Move& move) {
+		int count = moveList.moveCount;
+		if (count == 0)
+			return false;
+		chess::ScoredMove* moves = moveList.moves;
+		int best = count - 1;
+		for (int i = count - 2; i >= 0; --i) {
+			if (moves[i].score > moves[best].score)
+				best = i;
+		}
+
+		move = chess::Move(moves[best].move);
+		moves[best] = moves[count - 1];
+		moveList.moveCount--;
+		return true;
+	}
+
+	typedef chess::Move TransitionType; // for compatability with minimax.h
+};
+
+typedef minimax::AbstractGame<chess::Board, ChessNetworkHeuristic<2>, ChessMoveIterator, ChessPlayer, int> ChessGameTypes;
+typedef minimax::Minimax<ChessGameTypes, true, std::integral_constant<int, 4>, std::integral_constant<int, 2>, std::integral_constant<int, 1>> ChessGameMinimax;
+
+#endif
@@ -1,78 +1,233 @@
 #include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <random>
 #include "chessboard.h"
-#include "minimax.h"
+#include "book.h"
+#include "tablebase.h"
+#include "chessgame.h"
+#include "transposition.h"
+#include "search.h"
+#include "parallel.h"
 #include <unistd.h>
 
 using namespace std;
 
-// basically just an integer but abstracted a bit
-struct ChessPlayer {
-	chess::Player player;
+void printTableCounters(const minimax::TranspositionTable& table, const minimax::TranspositionTable::Counters& counters) {
+	std::cout << "\ttt: probes " << counters.probes
+		<< " hits " << counters.hits
+		<< " (" << (counters.probes ? counters.hits * 100 / counters.probes : 0) << "%)"
+		<< " stores " << counters.stores
+		<< " collisions " << counters.collisions
+		<< " full " << table.hashfull() << "/1000" << std::endl;
+}
+
+void printIteration(const minimax::Search<ChessGameTypes>::Iteration& iteration) {
+	std::cout << "\tdepth " << iteration.depth
+		<< " score " << iteration.score
+		<< " nodes " << iteration.nodes
+		<< " time " << iteration.milliseconds << "ms"
+		<< " best " << iteration.pv[0].toCoordinate() << std::endl;
+}
 
-	inline ChessPlayer(chess::Player player) : player(player) {
-		
+// opened with -stats, a line of json per search
+std::ofstream statsFile;
+
+// opened with -book, varied between games by the dice
+chess::OpeningBook book;
+std::minstd_rand bookRandom(std::random_device{}());
+
+/*
+	play a book move if there is one, otherwise search for a move with the
+	runtime depth search, or the compile time one when fixed is set
+*/
+chess::Move findMove(minimax::ParallelSearch<ChessGameTypes>& search, minimax::TranspositionTable& table, const minimax::SearchLimits& limits, bool fixed, chess::Board* board, ChessPlayer player) {
+	chess::Move move;
+	if (book.probe(board, player.player, (uint32_t) bookRandom(), move)) {
+		std::cout << "\tbook move: " << move.toCoordinate() << std::endl;
+		return move;
 	}
 
-	inline ChessPlayer getOpponent() {
-		return ChessPlayer(-player);
+	search.newSearch(1); // warm from the last move's search, a ply earlier
+	search.resetCounters();
+
+	if (fixed) {
+		ChessGameMinimax::getBestMove(&search.contexts[0], board, player, INT_MIN, INT_MAX, move);
+	} else {
+		search.onIteration = printIteration;
+		search.iterate(board, player, limits, move);
+		std::cout << "\tnodes " << search.nodes
+			<< " cutoffs " << search.cutoffs
+			<< " first move cutoffs " << (search.cutoffs ? search.firstMoveCutoffs * 100 / search.cutoffs : 0) << "%" << std::endl;
+		std::cout << "\tnull move cutoffs " << search.nullMoveCutoffs
+			<< " reductions " << search.reductions
+			<< " re-searches " << search.reSearches
+			<< " futility prunes " << search.futilityPrunes << std::endl;
+		std::cout << "\troot searches " << search.rootSearches
+			<< " fail lows " << search.failLows
+			<< " fail highs " << search.failHighs
+			<< " tablebase hits " << search.tablebaseHits << std::endl;
+		if (search.getThreadCount() > 1) {
+			std::cout << "\tthread nodes";
+			for (uint64_t nodes : search.threadNodes)
+				std::cout << " " << nodes;
+			std::cout << std::endl;
+		}
+		if (statsFile.is_open()) {
+			search.writeStats(statsFile);
+			statsFile << std::endl;
+		}
 	}
-};
 
-template<int capture_threshold>
-struct ChessHeuristic {
-	inline static int getScore(chess::Board* board, ChessPlayer player) {
-		return board->getScore() * player.player;
+	std::cout << "\tmove: " << move.toCoordinate() << std::endl;
+	printTableCounters(table, search.getTableCounters());
+	return move;
+}
+
+/*
+	time to reach a fixed depth from the start position with 1, 2, 4 ... threads,
+	each run starting from an empty transposition table
+*/
+void speedupReport(minimax::TranspositionTable& table, int maxThreads, int depth) {
+	std::cout << "threads\ttime ms\tnodes\tnps\tspeedup" << std::endl;
+	int64_t baseline = 0;
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		chess::Board board;
+		chess::Move move;
+		minimax::SearchLimits limits;
+		limits.depth = depth;
+
+		table.clear();
+		minimax::ParallelSearch<ChessGameTypes> search(&table, threads);
+		auto start = std::chrono::steady_clock::now();
+		search.iterate(&board, ChessPlayer(1), limits, move);
+		int64_t milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		if (milliseconds < 1)
+			milliseconds = 1;
+		if (threads == 1)
+			baseline = milliseconds;
+
+		std::cout << threads << "\t" << milliseconds
+			<< "\t" << search.nodes
+			<< "\t" << search.nodes * 1000 / milliseconds
+			<< "\t" << (double) baseline / milliseconds << std::endl;
 	}
+}
 
-	inline static bool shouldSearchDeeper(chess::Board* boardA, chess::Board* boardB) {
-		int pieceCountOriginal = 0;
-		int pieceCountNow = 0;
-		for (int i = 0; i < chess::BOARD_SPACES; ++i) {
-			if (boardA->getPieceAt(i) != 0)
-				pieceCountOriginal++;
-			if (boardB->getPieceAt(i) != 0)
-				pieceCountNow++;
-		}
+int main(int argc, const char** args) {
+	cout << "Chess Engine v2 by Gareth George" << endl;
 
-		return pieceCountOriginal - pieceCountNow >= capture_threshold;
+	int hashMegabytes = 64;
+	int threads = 1;
+	int speedupThreads = 0;
+	bool fixed = false;
+	bool ordering = true;
+	const char* fen = nullptr;
+	minimax::SearchLimits limits;
+	minimax::SearchOptions options;
+	limits.milliseconds = 1000;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(args[i], "-hash") == 0 && i + 1 < argc)
+			hashMegabytes = atoi(args[++i]);
+		else if (strcmp(args[i], "-depth") == 0 && i + 1 < argc)
+			limits.depth = atoi(args[++i]);
+		else if (strcmp(args[i], "-movetime") == 0 && i + 1 < argc)
+			limits.milliseconds = atoll(args[++i]);
+		else if (strcmp(args[i], "-nodes") == 0 && i + 1 < argc)
+			limits.nodes = strtoull(args[++i], nullptr, 10);
+		else if (strcmp(args[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(args[++i]);
+		else if (strcmp(args[i], "-speedup") == 0 && i + 1 < argc)
+			speedupThreads = atoi(args[++i]);
+		else if (strcmp(args[i], "-fixed") == 0)
+			fixed = true;
+		else if (strcmp(args[i], "-noordering") == 0)
+			ordering = false;
+		else if (strcmp(args[i], "-nonull") == 0)
+			options.nullMove = false;
+		else if (strcmp(args[i], "-nolmr") == 0)
+			options.lateMoveReductions = false;
+		else if (strcmp(args[i], "-nofutility") == 0)
+			options.futility = false;
+		else if (strcmp(args[i], "-norfp") == 0)
+			options.reverseFutility = false;
+		else if (strcmp(args[i], "-noaspiration") == 0)
+			options.aspiration = false;
+		else if (strcmp(args[i], "-fen") == 0 && i + 1 < argc)
+			fen = args[++i];
+		else if (strcmp(args[i], "-window") == 0 && i + 1 < argc)
+			options.aspirationWindow = atoi(args[++i]);
+		else if (strcmp(args[i], "-book") == 0 && i + 1 < argc) {
+			if (!book.open(args[++i])) {
+				cerr << "could not load book " << args[i] << endl;
+				return 1;
+			}
+		}
+		else if (strcmp(args[i], "-tablebases") == 0 && i + 1 < argc) {
+			if (chess::tablebases.open(args[++i]) == 0) {
+				cerr << "no tablebases found in " << args[i] << endl;
+				return 1;
+			}
+		}
+		else if (strcmp(args[i], "-stats") == 0 && i + 1 < argc) {
+			if (!minimax::SearchStats::ENABLED) {
+				cerr << "-stats needs a build with MINIMAX_STATS, see make stats" << endl;
+				return 1;
+			}
+			statsFile.open(args[++i], ios::app);
+			if (!statsFile) {
+				cerr << "could not open " << args[i] << endl;
+				return 1;
+			}
+		}
+		else if (strcmp(args[i], "-nnue") == 0 && i + 1 < argc) {
+			if (!chess::nnueLoad(args[++i])) {
+				cerr << "could not load network " << args[i] << endl;
+				return 1;
+			}
+		}
 	}
-};
 
-struct ChessMoveIterator {
-	chess::MoveIterator moveIterator;
-	inline ChessMoveIterator(chess::Board* board, ChessPlayer player) : moveIterator(board, player.player) { };
-	inline bool getNext(chess::Move& move) { return moveIterator.getNext(move); };
-	typedef chess::Move TransitionType; // for compatability with minimax.h
-};
+	minimax::TranspositionTable table(hashMegabytes);
+	cout << "transposition table: " << table.getSizeBytes() / (1024 * 1024) << "MB" << endl;
 
-typedef minimax::AbstractGame<chess::Board, ChessHeuristic<2>, ChessMoveIterator, ChessPlayer, int> ChessGameTypes;
-typedef minimax::Minimax<ChessGameTypes, true, std::integral_constant<int, 4>, std::integral_constant<int, 2>, std::integral_constant<int, 1>> ChessGameMinimax;
+	if (speedupThreads > 0) {
+		speedupReport(table, speedupThreads, limits.depth > 0 ? limits.depth : 7);
+		return 0;
+	}
 
-int main(int argc, const char** args) {
-	cout << "Chess Engine v2 by Gareth George" << endl;
+	minimax::ParallelSearch<ChessGameTypes> search(&table, threads);
+	search.options = options;
+	for (minimax::SearchContext& context : search.contexts)
+		context.ordering.enabled = ordering;
 
-	ChessPlayer player1(1);
-	ChessPlayer player2(-1);
+	ChessPlayer player(1);
 	chess::Board board;
+	chess::Move::Undo undo;
+	if (fen) {
+		// parsed after the network is loaded, the board's accumulator is set up from it
+		chess::Player fenPlayer;
+		if (!chess::parseFen(fen, &board, fenPlayer)) {
+			cerr << "invalid fen " << fen << endl;
+			return 1;
+		}
+		player = ChessPlayer(fenPlayer);
+		board.print();
+	}
 
 	int moveCount = 0;
 	while (true) {
-		std::cout << "Move #" << ++moveCount << " @ PLAYER 1" << std::endl;
-		chess::Move move;
-		ChessGameMinimax::getBestMove(&board, player1, INT_MIN, INT_MAX, move);
-		std::cout << "\tmove: " << move.toString() << std::endl;
-		assert(!(move.changes[1].piece == 0));
-		move.apply(&board);
-		board.print();
-
-
-		std::cout << "Move #" << ++moveCount << " @ PLAYER 2" << std::endl;
-		ChessGameMinimax::getBestMove(&board, player2, INT_MIN, INT_MAX, move);
-		std::cout << "\tmove: " << move.toString() << std::endl;
-		assert(!(move.changes[1].piece == 0));
-		move.apply(&board);
+		std::cout << "Move #" << ++moveCount << " @ PLAYER " << player.getIndex() + 1 << std::endl;
+		chess::Move move = findMove(search, table, limits, fixed, &board, player);
+		if (move.isNull()) {
+			std::cout << (board.isInCheck(player.player) ? "checkmate" : "stalemate") << std::endl;
+			break;
+		}
+		move.apply(&board, undo);
 		board.print();
-
+		player = player.getOpponent();
 	}
 
 	cout << "Done, shutdown." << endl;
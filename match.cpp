@@ -0,0 +1,363 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include "chessboard.h"
+#include "book.h"
+#include "tablebase.h"
+#include "chessgame.h"
+#include "transposition.h"
+#include "search.h"
+#include "parallel.h"
+
+using namespace std;
+
+/*
+	match
+	plays self-play games headless, several at once, one game per thread
+	with its own board, transposition table and move ordering. games start
+	from the book and a few random moves so they differ, and are cut short
+	once one side is far enough ahead on material or the game runs too long.
+	finished games are written as pgn or in a compact binary form:
+		uint8_t  result        0 draw, 1 white won, 2 black won
+		uint8_t  termination   a Termination
+		uint16_t plies
+		uint16_t moves[plies]  packed moves from the start position
+*/
+enum Result {
+	RESULT_DRAW,
+	RESULT_WHITE,
+	RESULT_BLACK
+};
+
+enum Termination {
+	TERMINATION_CHECKMATE,
+	TERMINATION_STALEMATE,
+	TERMINATION_REPETITION,
+	TERMINATION_FIFTY_MOVES,
+	TERMINATION_INSUFFICIENT_MATERIAL,
+	TERMINATION_MATERIAL,  // adjudicated, one side stayed far enough ahead
+	TERMINATION_MOVE_LIMIT // adjudicated as a draw
+};
+
+const char* resultName(int result) {
+	return result == RESULT_WHITE ? "1-0" : result == RESULT_BLACK ? "0-1" : "1/2-1/2";
+}
+
+const char* terminationName(int termination) {
+	switch (termination) {
+		case TERMINATION_CHECKMATE:
+			return "checkmate";
+		case TERMINATION_STALEMATE:
+			return "stalemate";
+		case TERMINATION_REPETITION:
+			return "repetition";
+		case TERMINATION_FIFTY_MOVES:
+			return "fifty moves";
+		case TERMINATION_INSUFFICIENT_MATERIAL:
+			return "insufficient material";
+		case TERMINATION_MATERIAL:
+			return "adjudicated on material";
+		default:
+			return "adjudicated at the move limit";
+	}
+}
+
+struct MatchOptions {
+	int games;
+	int concurrency;
+	int hashMegabytes;      // per game
+	minimax::SearchLimits limits;
+	int bookPlies;          // most plies taken from the book
+	int randomPlies;        // random moves played after the book
+	int maxPlies;           // a draw after this many, 0 for no limit
+	int adjudicateMaterial; // a win once one side is this many pawns ahead, 0 to play on
+	int adjudicatePlies;    // ... for this many plies in a row
+	uint32_t seed;
+
+	MatchOptions() : games(100), concurrency(1), hashMegabytes(16), bookPlies(16), randomPlies(4), maxPlies(400), adjudicateMaterial(6), adjudicatePlies(8), seed(0) {
+		limits.depth = 6;
+	}
+};
+
+struct Game {
+	int round;
+	int result;
+	int termination;
+	vector<chess::Move> moves;
+	uint64_t nodes;
+};
+
+chess::OpeningBook book;
+
+// neither side can mate: two kings, or a king and one minor piece against a king
+bool isInsufficientMaterial(const chess::Board& board) {
+	const chess::Bitboard occupied = board.getOccupied();
+	const int count = chess::bitboardCount(occupied);
+	if (count == 2)
+		return true;
+	return count == 3 && (occupied & (board.byType[chess::PIECE_KNIGHT] | board.byType[chess::PIECE_BISHOP])) != 0;
+}
+
+/*
+	plays one game from the start position, search is kept from game to game
+	by the thread but cleared in between. the book and random moves only
+	depend on the seed and the round, whichever thread plays it.
+*/
+Game playGame(minimax::ParallelSearch<ChessGameTypes>& search, const MatchOptions& options, int round) {
+	Game game;
+	game.round = round;
+	game.nodes = 0;
+	search.clear();
+	seed_seq seed = { options.seed, (uint32_t) round };
+	minstd_rand random(seed);
+
+	chess::Board board;
+	ChessPlayer player(1);
+	vector<uint64_t> hashes; // of every position since the last capture or pawn move
+	int leadPlies = 0;       // plies in a row one side has been adjudicateMaterial ahead
+	int leader = 0;
+	bool inBook = true;
+	int randomPlies = options.randomPlies;
+
+	while (true) {
+		const int ply = (int) game.moves.size();
+		hashes.push_back(board.getHash() ^ player.getHash());
+
+		chess::MoveIterator legal(&board, player.player);
+		if (legal.moveCount == 0) {
+			const bool mated = board.isInCheck(player.player);
+			game.result = !mated ? RESULT_DRAW : player.player > 0 ? RESULT_BLACK : RESULT_WHITE;
+			game.termination = mated ? TERMINATION_CHECKMATE : TERMINATION_STALEMATE;
+			return game;
+		}
+
+		int repeats = 0;
+		for (size_t i = 0; i + 1 < hashes.size(); ++i)
+			repeats += hashes[i] == hashes.back();
+		game.termination = -1;
+		if (repeats >= 2)
+			game.termination = TERMINATION_REPETITION;
+		else if (hashes.size() > 100)
+			game.termination = TERMINATION_FIFTY_MOVES;
+		else if (isInsufficientMaterial(board))
+			game.termination = TERMINATION_INSUFFICIENT_MATERIAL;
+		else if (options.maxPlies && ply >= options.maxPlies)
+			game.termination = TERMINATION_MOVE_LIMIT;
+		if (game.termination >= 0) {
+			game.result = RESULT_DRAW;
+			return game;
+		}
+
+		// the book first, then a few random moves, then the search
+		chess::Move move;
+		inBook = inBook && ply < options.bookPlies && book.probe(&board, player.player, (uint32_t) random(), move);
+		if (!inBook && randomPlies > 0) {
+			move = legal.getMove((int) (random() % legal.moveCount));
+			randomPlies--;
+		} else if (!inBook) {
+			search.newSearch(1);
+			search.iterate(&board, player, options.limits, move);
+			game.nodes += search.nodes;
+		}
+
+		if (options.adjudicateMaterial) {
+			const int material = board.getScore();
+			const int side = material >= options.adjudicateMaterial ? 1 : material <= -options.adjudicateMaterial ? -1 : 0;
+			leadPlies = side == 0 ? 0 : side == leader ? leadPlies + 1 : 1;
+			leader = side;
+			if (leadPlies >= options.adjudicatePlies) {
+				game.result = leader > 0 ? RESULT_WHITE : RESULT_BLACK;
+				game.termination = TERMINATION_MATERIAL;
+				return game;
+			}
+		}
+
+		const chess::Piece moved = board.getPieceAt(move.getFrom());
+		const bool irreversible = moved == chess::PIECE_PAWN || moved == -chess::PIECE_PAWN || move.isCapture(&board);
+		chess::Move::Undo undo;
+		move.apply(&board, undo);
+		player = player.getOpponent();
+		game.moves.push_back(move);
+		if (irreversible)
+			hashes.clear();
+	}
+}
+
+void writePgn(ostream& out, const Game& game) {
+	char date[16];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+
+	out << "[Event \"self-play\"]\n"
+		<< "[Site \"?\"]\n"
+		<< "[Date \"" << date << "\"]\n"
+		<< "[Round \"" << game.round << "\"]\n"
+		<< "[White \"Chess Engine v2\"]\n"
+		<< "[Black \"Chess Engine v2\"]\n"
+		<< "[Result \"" << resultName(game.result) << "\"]\n"
+		<< "[Termination \"" << terminationName(game.termination) << "\"]\n"
+		<< "[PlyCount \"" << game.moves.size() << "\"]\n\n";
+
+	chess::Board board;
+	chess::Player player = 1;
+	size_t lineLength = 0;
+	for (size_t i = 0; i < game.moves.size(); ++i) {
+		string text = chess::moveToSan(&board, player, game.moves[i]);
+		if (i % 2 == 0)
+			text = to_string(i / 2 + 1) + ". " + text;
+		if (lineLength + text.size() + 1 > 79) {
+			out << "\n";
+			lineLength = 0;
+		} else if (lineLength) {
+			out << " ";
+			lineLength++;
+		}
+		out << text;
+		lineLength += text.size();
+
+		chess::Move::Undo undo;
+		game.moves[i].apply(&board, undo);
+		player = -player;
+	}
+	out << (lineLength ? " " : "") << resultName(game.result) << "\n\n";
+}
+
+void writeBinary(ostream& out, const Game& game) {
+	const uint8_t header[2] = { (uint8_t) game.result, (uint8_t) game.termination };
+	const uint16_t plies = (uint16_t) game.moves.size();
+	out.write((const char*) header, sizeof(header));
+	out.write((const char*) &plies, sizeof(plies));
+	for (const chess::Move& move : game.moves) {
+		const uint16_t packed = move.pack();
+		out.write((const char*) &packed, sizeof(packed));
+	}
+}
+
+int main(int argc, const char** args) {
+	MatchOptions options;
+	options.concurrency = (int) thread::hardware_concurrency();
+	options.seed = random_device{}();
+	const char* pgnPath = nullptr;
+	const char* binaryPath = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(args[i], "-games") == 0 && i + 1 < argc)
+			options.games = atoi(args[++i]);
+		else if (strcmp(args[i], "-concurrency") == 0 && i + 1 < argc)
+			options.concurrency = atoi(args[++i]);
+		else if (strcmp(args[i], "-hash") == 0 && i + 1 < argc)
+			options.hashMegabytes = atoi(args[++i]);
+		else if (strcmp(args[i], "-depth") == 0 && i + 1 < argc)
+			options.limits.depth = atoi(args[++i]);
+		else if (strcmp(args[i], "-movetime") == 0 && i + 1 < argc)
+			options.limits.milliseconds = atoll(args[++i]);
+		else if (strcmp(args[i], "-nodes") == 0 && i + 1 < argc)
+			options.limits.nodes = strtoull(args[++i], nullptr, 10);
+		else if (strcmp(args[i], "-bookplies") == 0 && i + 1 < argc)
+			options.bookPlies = atoi(args[++i]);
+		else if (strcmp(args[i], "-random") == 0 && i + 1 < argc)
+			options.randomPlies = atoi(args[++i]);
+		else if (strcmp(args[i], "-maxplies") == 0 && i + 1 < argc)
+			options.maxPlies = atoi(args[++i]);
+		else if (strcmp(args[i], "-adjudicate") == 0 && i + 2 < argc) {
+			options.adjudicateMaterial = atoi(args[++i]);
+			options.adjudicatePlies = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "-seed") == 0 && i + 1 < argc)
+			options.seed = (uint32_t) strtoul(args[++i], nullptr, 10);
+		else if (strcmp(args[i], "-pgn") == 0 && i + 1 < argc)
+			pgnPath = args[++i];
+		else if (strcmp(args[i], "-binary") == 0 && i + 1 < argc)
+			binaryPath = args[++i];
+		else if (strcmp(args[i], "-book") == 0 && i + 1 < argc) {
+			if (!book.open(args[++i])) {
+				cerr << "could not load book " << args[i] << endl;
+				return 1;
+			}
+		}
+		else if (strcmp(args[i], "-tablebases") == 0 && i + 1 < argc) {
+			if (chess::tablebases.open(args[++i]) == 0) {
+				cerr << "no tablebases found in " << args[i] << endl;
+				return 1;
+			}
+		}
+		else if (strcmp(args[i], "-nnue") == 0 && i + 1 < argc) {
+			if (!chess::nnueLoad(args[++i])) {
+				cerr << "could not load network " << args[i] << endl;
+				return 1;
+			}
+		}
+		else {
+			cerr << "usage: " << args[0] << " [-games n] [-concurrency n] [-hash mb] [-depth n] [-movetime ms] [-nodes n]"
+				<< " [-book file] [-bookplies n] [-random n] [-maxplies n] [-adjudicate pawns plies] [-seed n]"
+				<< " [-tablebases dir] [-nnue file] [-pgn file] [-binary file]" << endl;
+			return 1;
+		}
+	}
+	if (options.concurrency < 1)
+		options.concurrency = 1;
+	if (options.limits.depth == 0 && options.limits.milliseconds == 0 && options.limits.nodes == 0) {
+		cerr << "a game needs a depth, movetime or nodes limit" << endl;
+		return 1;
+	}
+
+	ofstream pgn, binary;
+	if (pgnPath)
+		pgn.open(pgnPath);
+	if (binaryPath)
+		binary.open(binaryPath, ios::binary);
+	if ((pgnPath && !pgn) || (binaryPath && !binary)) {
+		cerr << "could not open the output files" << endl;
+		return 1;
+	}
+
+	// finished games are written and counted one at a time
+	mutex finishedLock;
+	int finished = 0;
+	int results[3] = { 0, 0, 0 };
+	uint64_t nodes = 0;
+	atomic<int> nextRound(1);
+	auto start = chrono::steady_clock::now();
+
+	vector<thread> workers;
+	for (int i = 0; i < options.concurrency; ++i) {
+		workers.emplace_back([&]() {
+			minimax::TranspositionTable table(options.hashMegabytes);
+			minimax::ParallelSearch<ChessGameTypes> search(&table, 1);
+			for (int round = nextRound++; round <= options.games; round = nextRound++) {
+				Game game = playGame(search, options, round);
+
+				lock_guard<mutex> lock(finishedLock);
+				if (pgnPath)
+					writePgn(pgn, game);
+				if (binaryPath)
+					writeBinary(binary, game);
+				finished++;
+				results[game.result]++;
+				nodes += game.nodes;
+
+				const double hours = chrono::duration<double>(chrono::steady_clock::now() - start).count() / 3600;
+				cout << "game " << round << " " << resultName(game.result) << " " << terminationName(game.termination)
+					<< " " << game.moves.size() << " plies, "
+					<< finished << "/" << options.games << " +" << results[RESULT_WHITE] << " =" << results[RESULT_DRAW] << " -" << results[RESULT_BLACK]
+					<< ", " << (int) (finished / hours) << " games/hour" << endl;
+			}
+		});
+	}
+	for (thread& worker : workers)
+		worker.join();
+
+	const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << finished << " games in " << (int) seconds << "s with " << options.concurrency << " threads: "
+		<< (int) (finished * 3600 / seconds) << " games/hour, " << (uint64_t) (nodes / seconds) << " nodes/s" << endl;
+	cout << "white " << results[RESULT_WHITE] << " draws " << results[RESULT_DRAW] << " black " << results[RESULT_BLACK] << endl;
+	return 0;
+}
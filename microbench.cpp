@@ -0,0 +1,246 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include "chessboard.h"
+#include "chessgame.h"
+
+using namespace std;
+
+/*
+	microbench
+	times the hot paths of the board one at a time, in nanoseconds per
+	operation, over every position along the games of openings.txt:
+		- generateMoves, generateCaptures and generateQuiets per position
+		- the legal targets of one piece, per piece type
+		- Move::apply and revert as a pair, for every legal move
+		- the material and tapered scores
+		- ChessHeuristic::shouldSearchDeeper between a position and its children
+		- copying a Board
+	each kernel is warmed up, then timed over several samples long enough to
+	read the clock reliably. the result is one json object per line: the
+	median with the fastest and slowest sample, to compare between builds.
+*/
+
+// keeps the compiler from dropping work whose result is never used
+template<typename T>
+inline void keep(const T& value) {
+	asm volatile("" : : "r"(&value) : "memory");
+}
+
+struct CorpusPosition {
+	chess::Board board;
+	chess::Player player;
+	vector<chess::Move> moves;
+};
+
+// every position along every game of the file, see bookgen for the format
+bool loadCorpus(const char* path, vector<CorpusPosition>& corpus) {
+	ifstream games(path);
+	if (!games)
+		return false;
+
+	string line;
+	while (getline(games, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		chess::Board board;
+		chess::Player player = 1;
+		istringstream moves(line);
+		string text;
+		while (true) {
+			CorpusPosition position = { board, player, { } };
+			chess::MoveIterator legal(&board, player);
+			for (int i = 0; i < legal.moveCount; ++i)
+				position.moves.push_back(legal.getMove(i));
+			corpus.push_back(position);
+
+			chess::Move move;
+			if (!(moves >> text) || !chess::parseMove(&board, player, text, move))
+				break;
+			chess::Move::Undo undo;
+			move.apply(&board, undo);
+			player = -player;
+		}
+	}
+	return !corpus.empty();
+}
+
+/*
+	pass runs the kernel once over the corpus and returns how many operations
+	that was. passes are grouped into samples of at least SAMPLE_SECONDS.
+*/
+void measure(const string& name, const function<uint64_t()>& pass, int samples) {
+	const double WARMUP_SECONDS = 0.05;
+	const double SAMPLE_SECONDS = 0.02;
+	typedef chrono::steady_clock Clock;
+
+	// warm the caches and branch predictors, and find how many passes make a sample
+	int passes = 0;
+	auto start = Clock::now();
+	double seconds;
+	do {
+		pass();
+		passes++;
+		seconds = chrono::duration<double>(Clock::now() - start).count();
+	} while (seconds < WARMUP_SECONDS);
+	int passesPerSample = (int) (passes * SAMPLE_SECONDS / seconds) + 1;
+
+	vector<double> results;
+	uint64_t operations = 0;
+	for (int sample = 0; sample < samples; ++sample) {
+		operations = 0;
+		start = Clock::now();
+		for (int i = 0; i < passesPerSample; ++i)
+			operations += pass();
+		seconds = chrono::duration<double>(Clock::now() - start).count();
+		results.push_back(seconds * 1e9 / operations);
+	}
+	sort(results.begin(), results.end());
+
+	cout << "{\"kernel\":\"" << name << "\""
+		<< ",\"nsPerOp\":" << results[results.size() / 2]
+		<< ",\"min\":" << results.front()
+		<< ",\"max\":" << results.back()
+		<< ",\"opsPerSample\":" << operations
+		<< ",\"samples\":" << samples << "}" << endl;
+}
+
+int main(int argc, const char** args) {
+	const char* corpusPath = "openings.txt";
+	int samples = 15;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(args[i], "-samples") == 0 && i + 1 < argc)
+			samples = atoi(args[++i]);
+		else
+			corpusPath = args[i];
+	}
+	if (samples < 1)
+		samples = 1;
+
+	vector<CorpusPosition> corpus;
+	if (!loadCorpus(corpusPath, corpus)) {
+		cerr << "usage: " << args[0] << " [-samples n] [games file, openings.txt by default]" << endl;
+		return 1;
+	}
+
+	uint64_t moveCount = 0;
+	for (const CorpusPosition& position : corpus)
+		moveCount += position.moves.size();
+	cout << "{\"corpus\":\"" << corpusPath << "\",\"positions\":" << corpus.size() << ",\"moves\":" << moveCount
+		<< ",\"boardBytes\":" << sizeof(chess::Board) << ",\"compiler\":\"" << __VERSION__ << "\"}" << endl;
+
+	// the move generator, a whole position at a time
+	measure("generateMoves", [&]() {
+		for (CorpusPosition& position : corpus) {
+			chess::MoveList list;
+			chess::generateMoves<chess::MoveList>(&position.board, position.player, list);
+			keep(list);
+		}
+		return (uint64_t) corpus.size();
+	}, samples);
+	measure("generateCaptures", [&]() {
+		for (CorpusPosition& position : corpus) {
+			chess::MoveList list;
+			chess::generateCaptures<chess::MoveList>(&position.board, position.player, list);
+			keep(list);
+		}
+		return (uint64_t) corpus.size();
+	}, samples);
+	measure("generateQuiets", [&]() {
+		for (CorpusPosition& position : corpus) {
+			chess::MoveList list;
+			chess::generateQuiets<chess::MoveList>(&position.board, position.player, list);
+			keep(list);
+		}
+		return (uint64_t) corpus.size();
+	}, samples);
+
+	// one piece at a time, the legality work for its position included
+	const chess::Piece types[] = { chess::PIECE_PAWN, chess::PIECE_KNIGHT, chess::PIECE_BISHOP, chess::PIECE_ROOK, chess::PIECE_QUEEN, chess::PIECE_KING };
+	for (chess::Piece type : types) {
+		vector<pair<size_t, int>> pieces; // corpus index and square
+		for (size_t i = 0; i < corpus.size(); ++i) {
+			chess::Bitboard squares = corpus[i].board.getPieces(corpus[i].player, type);
+			while (squares)
+				pieces.push_back(make_pair(i, chess::bitboardPop(squares)));
+		}
+		if (pieces.empty())
+			continue;
+
+		measure(string("targets.") + (char) (chess::pieceGetLetter(type) - 'A' + 'a'), [&]() {
+			chess::Bitboard all = 0;
+			for (const auto& piece : pieces)
+				all ^= chess::getMoveTargets(&corpus[piece.first].board, corpus[piece.first].player, piece.second);
+			keep(all);
+			return (uint64_t) pieces.size();
+		}, samples);
+	}
+
+	// make and unmake, the search's inner loop
+	measure("applyRevert", [&]() {
+		for (CorpusPosition& position : corpus) {
+			for (const chess::Move& move : position.moves) {
+				chess::Move::Undo undo;
+				move.apply(&position.board, undo);
+				keep(position.board);
+				move.revert(&position.board, undo);
+			}
+		}
+		return moveCount;
+	}, samples);
+
+	measure("getScore", [&]() {
+		int64_t sum = 0;
+		for (const CorpusPosition& position : corpus) {
+			sum += position.board.getScore();
+			keep(sum);
+		}
+		return (uint64_t) corpus.size();
+	}, samples);
+	measure("getTaperedScore", [&]() {
+		int64_t sum = 0;
+		for (const CorpusPosition& position : corpus) {
+			sum += position.board.getTaperedScore();
+			keep(sum);
+		}
+		return (uint64_t) corpus.size();
+	}, samples);
+
+	// a few children of every position, captures first so some of them count
+	vector<pair<size_t, chess::Board>> children;
+	for (size_t i = 0; i < corpus.size(); ++i) {
+		vector<chess::Move> moves = corpus[i].moves;
+		stable_partition(moves.begin(), moves.end(), [&](const chess::Move& move) { return move.isCapture(&corpus[i].board); });
+		for (size_t j = 0; j < moves.size() && j < 4; ++j) {
+			chess::Board child = corpus[i].board;
+			chess::Move::Undo undo;
+			moves[j].apply(&child, undo);
+			children.push_back(make_pair(i, child));
+		}
+	}
+	measure("shouldSearchDeeper", [&]() {
+		int deeper = 0;
+		for (auto& child : children) {
+			deeper += ChessHeuristic<2>::shouldSearchDeeper(&corpus[child.first].board, &child.second);
+			keep(deeper);
+		}
+		return (uint64_t) children.size();
+	}, samples);
+
+	measure("boardCopy", [&]() {
+		for (const CorpusPosition& position : corpus) {
+			chess::Board copy = position.board;
+			keep(copy);
+		}
+		return (uint64_t) corpus.size();
+	}, samples);
+	return 0;
+}
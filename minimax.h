@@ -3,24 +3,61 @@
 
 #include <type_traits>
 #include <stdint.h>
+#include <climits>
+#include <limits>
 #include <cassert>
+#include <new>
+#include <memory>
+#include <utility>
+#include "transposition.h"
+#include "ordering.h"
 
 /*
 namespace minimax_concepts {
+	struct Board {
+		// hash of the position, must be kept up to date as moves are applied
+		uint64_t getHash() const;
+	};
+
 	template<int color>
 	struct MPlayer {
 		Player getOpponent() const;
+		// hash key xor'd with the board hash to tell apart the player to move
+		uint64_t getHash() const;
+		// 0 for the first player, 1 for the second
+		int getIndex() const;
 	};
 
 	struct Move {
-		// applys or reverts the move!
-		void toggle(Board* board); 
+		// whatever apply has to remember for revert
+		typedef ... Undo;
+
+		// default constructs to the null move
+		Move();
+
+		void apply(Board* board, Undo& undo) const;
+		void revert(Board* board, const Undo& undo) const;
+
+		// pass the turn, for null move pruning
+		static void applyNull(Board* board, Undo& undo);
+		static void revertNull(Board* board, const Undo& undo);
+
+		// 16 bit encoding for the transposition table, 0 must be the null move
+		uint16_t pack() const;
+		static Move unpack(const Board* board, uint16_t packed);
+
+		// true if the move takes something or otherwise changes the material,
+		// killers and history only track quiet moves
+		bool isNoisy(const Board* board) const;
 	};
 
 	template<class PLAYER>
 	struct MMoveIterator {
 		typedef Move TransitionType;
-		NMoveIterator(Board* board, Player player);
+		// hints say which moves should be returned first, see ordering.h,
+		// and with hints.noisyOnly that only noisy moves are wanted.
+		// only legal moves may be returned, no moves means the game is over
+		NMoveIterator(Board* board, Player player, const OrderingHints& hints);
 
 		inline bool getNext(transitionType& move) = 0;
 	};
@@ -32,7 +69,29 @@ namespace minimax_concepts {
 		// higher values are good for us
 		// lower values good for opponent
 
-		static int getScore(Board* board) = 0;
+		static int getScore(Board* board, Player player) = 0;
+
+		// score of a position where player has no moves, ply is the distance
+		// from the root so quicker wins can score higher
+		static int getTerminalScore(Board* board, Player player, int ply) = 0;
+		// the score of being mated at the root, the transposition table keeps
+		// scores near it relative to the node they were found at
+		static const int SCORE_MATE;
+
+		// true if the line from original to now is too tactical to stop at,
+		// the deeper... plies of a Minimax are searched when it is
+		static bool shouldSearchDeeper(Board* original, Board* now) = 0;
+
+		// selective search, see SearchOptions in search.h
+		// positions where player is under a direct threat are never pruned
+		static bool isInCheck(Board* board, Player player) = 0;
+		// false where passing could be the best move, so a null move proves nothing
+		static bool allowNullMove(Board* board, Player player) = 0;
+		// how far the score of a quiet position may move in one ply
+		static const int FUTILITY_MARGIN;
+		// the exact score of a position known from tables, ply from the root
+		// for mate distances. false when the position isn't in them
+		static bool probeTablebase(Board* board, Player player, int ply, int& score) = 0;
 	};
 }
 */
@@ -50,10 +109,138 @@ struct AbstractGame : public AbstractGameBaseClass {
 	typedef PLAYER PlayerType;
 	typedef SCORE ScoreType;
 	typedef typename IteratorType::TransitionType TransitionType;
+	typedef typename TransitionType::Undo UndoType;
 
 	typedef AbstractGame<BoardType, HeuristicType, IteratorType, PlayerType, ScoreType> nextTurn;
 };
 
+/*
+	sum of the depths of a list of std::integral_constant's, used to work out
+	how many plies are left below a node including the deeper... extensions
+*/
+template<typename... depths>
+struct DepthSum : std::integral_constant<int, 0> { };
+
+template<typename depth, typename... depths>
+struct DepthSum<depth, depths...> : std::integral_constant<int, depth::value + DepthSum<depths...>::value> { };
+
+/*
+	SearchContext
+	state shared by every node of a search, null tables are simply not used
+*/
+struct SearchContext {
+	TranspositionTable* table;
+	TranspositionTable::Counters tableCounters;
+	MoveOrdering ordering;
+
+	SearchContext(TranspositionTable* table = nullptr) : table(table) { }
+};
+
+/*
+	SearchStack
+	one preallocated frame per ply holding everything a node would otherwise
+	build on the call stack, so a search allocates and constructs nothing and
+	keeps touching the same memory. killers stay in MoveOrdering, also by ply.
+	a stack belongs to one thread and is reused from search to search.
+
+	AG - an abstract game
+*/
+template<class AG>
+struct SearchStack {
+	typedef typename AG::IteratorType IteratorType;
+
+	static_assert(std::is_trivially_destructible<IteratorType>::value, "iterators are rebuilt in place and never destroyed");
+
+	struct Frame {
+		alignas(IteratorType) unsigned char iterator[sizeof(IteratorType)];
+		typename AG::TransitionType transition; // the move being searched
+		typename AG::TransitionType trash;      // best moves of children nobody asked for
+		typename AG::UndoType undo;
+		typename AG::BoardType board;           // the position an extension started from
+
+		template<typename... ARGS>
+		inline IteratorType& makeIterator(ARGS&&... args) {
+			return *new (iterator) IteratorType(std::forward<ARGS>(args)...);
+		}
+	};
+
+	Frame frames[MAX_PLY];
+
+	inline Frame& operator[](int ply) {
+		return frames[ply];
+	}
+
+	// the calling thread's own stack, for callers that don't keep one
+	static SearchStack& local() {
+		static thread_local std::unique_ptr<SearchStack> stack;
+		if (!stack)
+			stack.reset(new SearchStack());
+		return *stack;
+	}
+};
+
+/*
+	NullVisitor
+	node visitor for Quiescence that never stops the search
+*/
+struct NullVisitor {
+	inline void visit() { }
+	inline bool aborted() const { return false; }
+};
+
+/*
+	Quiescence
+	searches only noisy moves below the horizon until the position is quiet, so a
+	leaf is never scored in the middle of an exchange. the player to move may
+	always stand pat on the heuristic score rather than take anything.
+	negamax form, scores are from the perspective of player.
+
+	VISITOR - told about every node with visit(), the search is abandoned once
+	          aborted() returns true
+
+	AG - an abstract game
+*/
+template<class AG>
+struct Quiescence {
+	typedef typename AG::ScoreType ScoreType;
+
+	template<class VISITOR>
+	static ScoreType run(VISITOR& visitor, SearchStack<AG>& stack, typename AG::BoardType* board, typename AG::PlayerType player, int ply, ScoreType alpha, ScoreType beta) {
+		visitor.visit();
+		if (visitor.aborted())
+			return 0;
+
+		typename SearchStack<AG>::Frame& frame = stack[ply];
+		ScoreType best = AG::HeuristicType::getScore(board, player);
+		if (best >= beta || ply >= MAX_PLY - 1)
+			return best;
+		if (best > alpha)
+			alpha = best;
+
+		typename AG::PlayerType nextPlayer = player.getOpponent();
+		typename AG::IteratorType& moveIterator = frame.makeIterator(board, player, OrderingHints(nullptr, ply, player.getIndex(), 0, true));
+
+		while (moveIterator.getNext(frame.transition)) {
+			frame.transition.apply(board, frame.undo);
+			ScoreType score = -run(visitor, stack, board, nextPlayer, ply + 1, -beta, -alpha);
+			frame.transition.revert(board, frame.undo);
+
+			if (visitor.aborted())
+				return 0;
+
+			if (score > best) {
+				best = score;
+				if (score > alpha)
+					alpha = score;
+				if (alpha >= beta)
+					break;
+			}
+		}
+
+		return best;
+	}
+};
+
 /*
 	AG - an abstract game
 */
@@ -66,62 +253,122 @@ struct Minimax {
 
 	typedef Minimax<typename AG::nextTurn, !maximizing, typename std::integral_constant<int, depth::value - 1>, deeper...> NextMinimax;
 
-	static typename AG::ScoreType getBestMove(typename AG::BoardType* board, typename AG::PlayerType player, typename AG::ScoreType alpha, typename AG::ScoreType beta, typename AG::TransitionType& bestTransition) {
-		typename AG::BoardType boardOriginal = *board; // copy the board so we have a reference to the original
-		typename AG::BoardType boardPassdown = *board; // copy of the board that we will pass down the algorithm calls
+	// plies left below this node, the depth recorded in the transposition table
+	static const int draft = DepthSum<depth, deeper...>::value;
+	static_assert(draft < MAX_PLY, "the search stack only has MAX_PLY frames");
 
-		return run(&boardOriginal, &boardPassdown, player, alpha, beta, bestTransition);
+	static constexpr typename AG::ScoreType SCORE_INFINITE = std::numeric_limits<typename AG::ScoreType>::max();
+
+	static typename AG::ScoreType getBestMove(typename AG::BoardType* board, typename AG::PlayerType player, typename AG::ScoreType alpha, typename AG::ScoreType beta, typename AG::TransitionType& bestTransition) {
+		return getBestMove(nullptr, board, player, alpha, beta, bestTransition);
 	}
 
-	static typename AG::ScoreType run(typename AG::BoardType* originalBoard, typename AG::BoardType* board, typename AG::PlayerType player, typename AG::ScoreType alpha, typename AG::ScoreType beta, typename AG::TransitionType& bestTransition) {
-		typename AG::PlayerType nextPlayer = player.getOpponent();
+	/*
+		scores from the perspective of player when maximizing, of the opponent otherwise
+	*/
+	static typename AG::ScoreType getBestMove(SearchContext* context, typename AG::BoardType* board, typename AG::PlayerType player, typename AG::ScoreType alpha, typename AG::ScoreType beta, typename AG::TransitionType& bestTransition) {
+		// keep the window symmetric so it can be negated
+		if (alpha < -SCORE_INFINITE)
+			alpha = -SCORE_INFINITE;
+
+		SearchStack<AG>& stack = SearchStack<AG>::local();
+		if (maximizing)
+			return search(context, stack, board, player, alpha, beta, bestTransition);
+		return -search(context, stack, board, player, -beta, -alpha, bestTransition);
+	}
 
-		typename AG::IteratorType moveIterator(board, player);
-		typename AG::IteratorType::TransitionType transition;
-		typename AG::IteratorType::TransitionType trash;
+	/*
+		negamax entry point, scores are from the perspective of player.
+		the board is searched in place and left as it was found
+	*/
+	static typename AG::ScoreType search(SearchContext* context, SearchStack<AG>& stack, typename AG::BoardType* board, typename AG::PlayerType player, typename AG::ScoreType alpha, typename AG::ScoreType beta, typename AG::TransitionType& bestTransition) {
+		stack[0].board = *board; // where the first extension is measured from
+		return run(context, stack, 0, &stack[0].board, board, player, alpha, beta, bestTransition);
+	}
 
-		// todo: template on maximizing vs minimizing!
-		if (maximizing) {
-			typename AG::ScoreType max = INT_MIN;
+	/*
+		principal variation search in negamax form: the first move gets the full
+		window, the rest are only proven worse with a null window and searched
+		again if that fails
+	*/
+	static typename AG::ScoreType run(SearchContext* context, SearchStack<AG>& stack, int ply, typename AG::BoardType* originalBoard, typename AG::BoardType* board, typename AG::PlayerType player, typename AG::ScoreType alpha, typename AG::ScoreType beta, typename AG::TransitionType& bestTransition) {
+		typename AG::PlayerType nextPlayer = player.getOpponent();
 
-			while (moveIterator.getNext(transition)) {
-				transition.apply(board);
-				typename AG::ScoreType score = NextMinimax::run(originalBoard, board, nextPlayer, alpha, beta, trash);
-				transition.apply(board);
+		TranspositionTable* table = context ? context->table : nullptr;
+		uint64_t hash = 0;
+		uint16_t hashMove = 0;
+		if (table) {
+			hash = board->getHash() ^ player.getHash();
 
-				if (score > max) {
-					bestTransition = transition;
-					max = score;
+			TranspositionTable::Entry entry;
+			if (table->probe(hash, entry, context->tableCounters)) {
+				hashMove = entry.move;
+				entry.score = TranspositionTable::fromTableScore(entry.score, ply, AG::HeuristicType::SCORE_MATE);
+			}
+			if (hashMove && entry.depth >= draft) {
+				if (entry.bound == TranspositionTable::BOUND_EXACT ||
+						(entry.bound == TranspositionTable::BOUND_LOWER && entry.score >= beta) ||
+						(entry.bound == TranspositionTable::BOUND_UPPER && entry.score <= alpha)) {
+					bestTransition = AG::TransitionType::unpack(board, entry.move);
+					return entry.score;
 				}
-
-				if (score > alpha)
-					alpha = score;
-				if (beta <= alpha)
-					break;
 			}
+		}
 
-			return max;
-		} else {
-			typename AG::ScoreType min = INT_MAX;
+		const typename AG::ScoreType alphaOriginal = alpha;
+		bool found = false;
+
+		MoveOrdering* ordering = context ? &context->ordering : nullptr;
+		typename SearchStack<AG>::Frame& frame = stack[ply];
+		typename AG::IteratorType& moveIterator = frame.makeIterator(board, player, OrderingHints(ordering, ply, player.getIndex(), hashMove));
+		typename AG::TransitionType& transition = frame.transition;
+
+		typename AG::ScoreType best = -SCORE_INFINITE;
+
+		while (moveIterator.getNext(transition)) {
+			transition.apply(board, frame.undo);
+			typename AG::ScoreType score;
+			if (!found) {
+				score = -NextMinimax::run(context, stack, ply + 1, originalBoard, board, nextPlayer, -beta, -alpha, frame.trash);
+			} else {
+				score = -NextMinimax::run(context, stack, ply + 1, originalBoard, board, nextPlayer, -alpha - 1, -alpha, frame.trash);
+				if (score > alpha && score < beta)
+					score = -NextMinimax::run(context, stack, ply + 1, originalBoard, board, nextPlayer, -beta, -alpha, frame.trash);
+			}
+			transition.revert(board, frame.undo);
 
-			while (moveIterator.getNext(transition)) {
-				transition.apply(board);
-				typename AG::ScoreType score = NextMinimax::run(originalBoard, board, nextPlayer, alpha, beta, trash);
-				transition.apply(board);
+			if (score > best || !found) {
+				bestTransition = transition;
+				best = score;
+				found = true;
+			}
 
-				if (score < min) {
-					bestTransition = transition;
-					min = score;
+			if (score > alpha)
+				alpha = score;
+			if (alpha >= beta) {
+				if (ordering && !transition.isNoisy(board)) {
+					ordering->addKiller(ply, transition.pack());
+					ordering->addHistory(player.getIndex(), transition.pack(), draft);
 				}
-
-				if (score < beta)
-					beta = score;
-				if (beta <= alpha)
-					break;
+				break;
 			}
+		}
+
+		// nothing to play, the game is over
+		if (!found)
+			return AG::HeuristicType::getTerminalScore(board, player, ply);
 
-			return min;
-		} 
+		if (table) {
+			TranspositionTable::Bound bound = TranspositionTable::BOUND_EXACT;
+			if (best <= alphaOriginal)
+				bound = TranspositionTable::BOUND_UPPER;
+			else if (best >= beta)
+				bound = TranspositionTable::BOUND_LOWER;
+
+			table->store(hash, bestTransition.pack(), TranspositionTable::toTableScore(best, ply, AG::HeuristicType::SCORE_MATE), draft, bound, context->tableCounters);
+		}
+
+		return best;
 	}
 };
 
@@ -131,12 +378,19 @@ struct Minimax<AG, maximizing, std::integral_constant<int, 0>, deeper...> {
 		static_assert(std::is_base_of<AbstractGameBaseClass, AG>::value, "template parameter AG must be a template specialization of AbstractGame.");
 	}
 
-	static typename AG::ScoreType run(typename AG::BoardType* originalBoard, typename AG::BoardType* board, typename AG::PlayerType player, int alpha, int beta, typename AG::TransitionType& trash) {
-		if (true) {
-			return Minimax<AG, maximizing, deeper...>::getBestMove(board, player, alpha, beta, trash);
+	/*
+		extend by the next depth in deeper... if the heuristic thinks the line
+		is still too sharp, otherwise settle it with a quiescence search
+	*/
+	static typename AG::ScoreType run(SearchContext* context, SearchStack<AG>& stack, int ply, typename AG::BoardType* originalBoard, typename AG::BoardType* board, typename AG::PlayerType player, typename AG::ScoreType alpha, typename AG::ScoreType beta, typename AG::TransitionType& trash) {
+		if (AG::HeuristicType::shouldSearchDeeper(originalBoard, board)) {
+			// the extension measures from here, its nodes use the frames below this one
+			stack[ply].board = *board;
+			return Minimax<AG, maximizing, deeper...>::run(context, stack, ply, &stack[ply].board, board, player, alpha, beta, trash);
 		}
 
-		return AG::HeuristicType::getScore(board, maximizing ? player : player.getOpponent());
+		NullVisitor visitor;
+		return Quiescence<AG>::run(visitor, stack, board, player, ply, alpha, beta);
 	}
 };
 
@@ -146,11 +400,11 @@ struct Minimax<AG, maximizing, std::integral_constant<int, 0>> {
 		static_assert(std::is_base_of<AbstractGameBaseClass, AG>::value, "template parameter AG must be a template specialization of AbstractGame.");
 	}
 
-	static typename AG::ScoreType run(typename AG::BoardType* originalBoard, typename AG::BoardType* board, typename AG::PlayerType player, int alpha, int beta, typename AG::TransitionType& trash) {
-		return AG::HeuristicType::getScore(board, maximizing ? player : player.getOpponent());
+	static typename AG::ScoreType run(SearchContext* context, SearchStack<AG>& stack, int ply, typename AG::BoardType* originalBoard, typename AG::BoardType* board, typename AG::PlayerType player, typename AG::ScoreType alpha, typename AG::ScoreType beta, typename AG::TransitionType& trash) {
+		NullVisitor visitor;
+		return Quiescence<AG>::run(visitor, stack, board, player, ply, alpha, beta);
 	}
 };
 
-
 }
 #endif
@@ -0,0 +1,153 @@
+#include "nnue.h"
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace chess {
+
+const NnueNetwork* nnueNetwork = nullptr;
+
+static NnueNetwork loadedNetwork;
+
+bool nnueLoad(const char* path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t) info.st_size != NNUE_FILE_SIZE) {
+		close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, NNUE_FILE_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+
+	const NnueHeader* header = (const NnueHeader*) mapping;
+	if (memcmp(header->magic, "NNUE", 4) != 0 || header->version != NNUE_VERSION
+			|| header->inputs != NNUE_INPUTS || header->hidden != NNUE_HIDDEN || header->l1 != NNUE_L1) {
+		munmap(mapping, NNUE_FILE_SIZE);
+		return false;
+	}
+
+	nnueUnload();
+
+	const char* data = (const char*) mapping + NNUE_HEADER_SIZE;
+	NnueNetwork& network = loadedNetwork;
+	network.featureWeights = (const int16_t*) data;
+	data += sizeof(int16_t) * NNUE_INPUTS * NNUE_HIDDEN;
+	network.featureBias = (const int16_t*) data;
+	data += sizeof(int16_t) * NNUE_HIDDEN;
+	network.l1Weights = (const int8_t*) data;
+	data += sizeof(int8_t) * NNUE_L1 * 2 * NNUE_HIDDEN;
+	network.l1Bias = (const int32_t*) data;
+	data += sizeof(int32_t) * NNUE_L1;
+	network.outputWeights = (const int8_t*) data;
+	data += sizeof(int8_t) * NNUE_L1;
+	memcpy(&network.outputBias, data, sizeof(int32_t));
+	network.outputScale = header->outputScale;
+	network.mapping = mapping;
+	network.mappingSize = NNUE_FILE_SIZE;
+
+	nnueNetwork = &network;
+	return true;
+}
+
+void nnueUnload() {
+	if (!nnueNetwork)
+		return;
+	munmap(loadedNetwork.mapping, loadedNetwork.mappingSize);
+	nnueNetwork = nullptr;
+}
+
+void nnueRefresh(NnueAccumulator& accumulator, const NnueNetwork& network, const int8_t* pieces) {
+	for (int perspective = 0; perspective < 2; ++perspective)
+		memcpy(accumulator.values[perspective], network.featureBias, sizeof(accumulator.values[perspective]));
+	for (int i = 0; i < 64; ++i) {
+		if (pieces[i] != 0)
+			nnueAddPiece(accumulator, network, pieces[i], i);
+	}
+}
+
+/*
+	clipped relu of both halves of the accumulator into one row of bytes,
+	the side to move first
+*/
+static inline void clipInputs(const NnueAccumulator& accumulator, int perspective, uint8_t* inputs) {
+	const int16_t* halves[2] = { accumulator.values[perspective], accumulator.values[perspective ^ 1] };
+	for (int half = 0; half < 2; ++half) {
+		const int16_t* values = halves[half];
+		uint8_t* out = inputs + half * NNUE_HIDDEN;
+#if defined(__AVX2__)
+		const __m256i ceiling = _mm256_set1_epi16(127);
+		for (int i = 0; i < NNUE_HIDDEN; i += 32) {
+			__m256i a = _mm256_min_epi16(_mm256_loadu_si256((const __m256i*) (values + i)), ceiling);
+			__m256i b = _mm256_min_epi16(_mm256_loadu_si256((const __m256i*) (values + i + 16)), ceiling);
+			// packus saturates negatives to 0 but interleaves the 128 bit lanes, permute puts them back
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+			_mm256_storeu_si256((__m256i*) (out + i), packed);
+		}
+#elif defined(__SSE2__)
+		const __m128i ceiling = _mm_set1_epi16(127);
+		for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+			__m128i a = _mm_min_epi16(_mm_loadu_si128((const __m128i*) (values + i)), ceiling);
+			__m128i b = _mm_min_epi16(_mm_loadu_si128((const __m128i*) (values + i + 8)), ceiling);
+			_mm_storeu_si128((__m128i*) (out + i), _mm_packus_epi16(a, b));
+		}
+#else
+		for (int i = 0; i < NNUE_HIDDEN; ++i)
+			out[i] = (uint8_t) (values[i] < 0 ? 0 : values[i] > 127 ? 127 : values[i]);
+#endif
+	}
+}
+
+// inputs in [0, 127] dotted with signed weights, the products fit maddubs without saturating
+static inline int32_t dot(const uint8_t* inputs, const int8_t* weights) {
+	const int size = 2 * NNUE_HIDDEN;
+#if defined(__AVX2__)
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum = _mm256_setzero_si256();
+	for (int i = 0; i < size; i += 32) {
+		__m256i products = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*) (inputs + i)), _mm256_loadu_si256((const __m256i*) (weights + i)));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+	}
+	__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+	return _mm_cvtsi128_si32(half);
+#elif defined(__SSSE3__)
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i sum = _mm_setzero_si128();
+	for (int i = 0; i < size; i += 16) {
+		__m128i products = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*) (inputs + i)), _mm_loadu_si128((const __m128i*) (weights + i)));
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(products, ones));
+	}
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+	return _mm_cvtsi128_si32(sum);
+#else
+	int32_t sum = 0;
+	for (int i = 0; i < size; ++i)
+		sum += inputs[i] * weights[i];
+	return sum;
+#endif
+}
+
+int nnueEvaluate(const NnueAccumulator& accumulator, const NnueNetwork& network, int perspective) {
+	uint8_t inputs[2 * NNUE_HIDDEN];
+	clipInputs(accumulator, perspective, inputs);
+
+	int32_t output = network.outputBias;
+	for (int i = 0; i < NNUE_L1; ++i) {
+		int32_t hidden = (dot(inputs, network.l1Weights + i * 2 * NNUE_HIDDEN) + network.l1Bias[i]) >> NNUE_L1_SHIFT;
+		hidden = hidden < 0 ? 0 : hidden > 127 ? 127 : hidden;
+		output += hidden * network.outputWeights[i];
+	}
+	return output * network.outputScale / NNUE_OUTPUT_SCALE;
+}
+
+}
@@ -0,0 +1,154 @@
+#ifndef __NNUE_H_
+#define __NNUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace chess {
+
+/*
+	NNUE
+	a small efficiently updatable network for scoring positions:
+		- 768 inputs, one per (piece, square) seen from each side, so a move only
+		  switches a handful of them on or off
+		- a first layer of NNUE_HIDDEN int16 neurons per side, the accumulator,
+		  which the board keeps up to date by adding and removing weight rows as
+		  pieces move instead of recomputing it
+		- clipped relu to [0, 127], then an int8 layer of NNUE_L1 neurons and an
+		  int8 output, the only parts computed per evaluation
+	avx2 or sse is used where the compiler targets it, plain loops otherwise.
+
+	the weights come from a file mapped into memory by nnueLoad, laid out as
+		NnueHeader, padded to 64 bytes
+		int16 featureWeights[NNUE_INPUTS][NNUE_HIDDEN]
+		int16 featureBias[NNUE_HIDDEN]
+		int8  l1Weights[NNUE_L1][2 * NNUE_HIDDEN]   side to move first
+		int32 l1Bias[NNUE_L1]
+		int8  outputWeights[NNUE_L1]
+		int32 outputBias
+	all little endian
+*/
+const int NNUE_INPUTS = 768;
+const int NNUE_HIDDEN = 128;
+const int NNUE_L1 = 32;
+const int NNUE_L1_SHIFT = 6;       // first layer sums are scaled down by this many bits before clipping
+const int NNUE_OUTPUT_SCALE = 64;  // centipawns = output * header.outputScale / NNUE_OUTPUT_SCALE
+const uint32_t NNUE_VERSION = 1;
+
+struct NnueHeader {
+	char magic[4]; // "NNUE"
+	uint32_t version;
+	uint32_t inputs;
+	uint32_t hidden;
+	uint32_t l1;
+	int32_t outputScale;
+};
+
+const size_t NNUE_HEADER_SIZE = 64;
+const size_t NNUE_FILE_SIZE = NNUE_HEADER_SIZE
+	+ sizeof(int16_t) * NNUE_INPUTS * NNUE_HIDDEN
+	+ sizeof(int16_t) * NNUE_HIDDEN
+	+ sizeof(int8_t) * NNUE_L1 * 2 * NNUE_HIDDEN
+	+ sizeof(int32_t) * NNUE_L1
+	+ sizeof(int8_t) * NNUE_L1
+	+ sizeof(int32_t);
+
+// views into the mapped file
+struct NnueNetwork {
+	const int16_t* featureWeights;
+	const int16_t* featureBias;
+	const int8_t* l1Weights;
+	const int32_t* l1Bias;
+	const int8_t* outputWeights;
+	int32_t outputBias;
+	int32_t outputScale;
+
+	void* mapping;
+	size_t mappingSize;
+};
+
+// the loaded network, null until nnueLoad succeeds
+extern const NnueNetwork* nnueNetwork;
+
+/*
+	maps the weights at path, replacing any network already loaded.
+	returns false and leaves the old network in place if the file can't be
+	read or its header doesn't match the layout above.
+	boards built before the call have stale accumulators, synchronize them.
+*/
+bool nnueLoad(const char* path);
+void nnueUnload();
+
+/*
+	first layer outputs for both sides, values[0] seen from player 1 and
+	values[1] from player -1, the board flipped so both look up the board
+*/
+struct NnueAccumulator {
+	int16_t values[2][NNUE_HIDDEN];
+};
+
+// input index of piece (signed as on the board) on index, seen from perspective
+inline int nnueFeature(int perspective, int8_t piece, int index) {
+	const bool own = (piece > 0) == (perspective == 0);
+	const int type = (piece < 0 ? -piece : piece) - 1;
+	const int square = perspective == 0 ? index : index ^ 56;
+	return ((own ? 0 : 6) + type) * 64 + square;
+}
+
+inline void nnueAddRow(int16_t* values, const int16_t* row) {
+#if defined(__AVX2__)
+	for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+		__m256i sum = _mm256_add_epi16(_mm256_loadu_si256((const __m256i*) (values + i)), _mm256_loadu_si256((const __m256i*) (row + i)));
+		_mm256_storeu_si256((__m256i*) (values + i), sum);
+	}
+#elif defined(__SSE2__)
+	for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+		__m128i sum = _mm_add_epi16(_mm_loadu_si128((const __m128i*) (values + i)), _mm_loadu_si128((const __m128i*) (row + i)));
+		_mm_storeu_si128((__m128i*) (values + i), sum);
+	}
+#else
+	for (int i = 0; i < NNUE_HIDDEN; ++i)
+		values[i] += row[i];
+#endif
+}
+
+inline void nnueSubtractRow(int16_t* values, const int16_t* row) {
+#if defined(__AVX2__)
+	for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+		__m256i difference = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*) (values + i)), _mm256_loadu_si256((const __m256i*) (row + i)));
+		_mm256_storeu_si256((__m256i*) (values + i), difference);
+	}
+#elif defined(__SSE2__)
+	for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+		__m128i difference = _mm_sub_epi16(_mm_loadu_si128((const __m128i*) (values + i)), _mm_loadu_si128((const __m128i*) (row + i)));
+		_mm_storeu_si128((__m128i*) (values + i), difference);
+	}
+#else
+	for (int i = 0; i < NNUE_HIDDEN; ++i)
+		values[i] -= row[i];
+#endif
+}
+
+// piece appeared on or left index
+inline void nnueAddPiece(NnueAccumulator& accumulator, const NnueNetwork& network, int8_t piece, int index) {
+	for (int perspective = 0; perspective < 2; ++perspective)
+		nnueAddRow(accumulator.values[perspective], network.featureWeights + nnueFeature(perspective, piece, index) * NNUE_HIDDEN);
+}
+
+inline void nnueRemovePiece(NnueAccumulator& accumulator, const NnueNetwork& network, int8_t piece, int index) {
+	for (int perspective = 0; perspective < 2; ++perspective)
+		nnueSubtractRow(accumulator.values[perspective], network.featureWeights + nnueFeature(perspective, piece, index) * NNUE_HIDDEN);
+}
+
+// recomputes the accumulator from the 64 squares of a board
+void nnueRefresh(NnueAccumulator& accumulator, const NnueNetwork& network, const int8_t* pieces);
+
+// centipawns from the point of view of perspective (0 for player 1, 1 for player -1)
+int nnueEvaluate(const NnueAccumulator& accumulator, const NnueNetwork& network, int perspective);
+
+}
+
+#endif
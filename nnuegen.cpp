@@ -0,0 +1,90 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include "evaluation.h"
+#include "nnue.h"
+
+using namespace std;
+
+/*
+	nnuegen
+	writes a network that plays like the piece-square tables, a starting point
+	to train from and something to exercise the evaluator with until then.
+
+	the tables are linear in the inputs, which the clipped layers can only pass
+	through in slices of 127: accumulator neuron j of each side sums the
+	(midgame + endgame) / 2 table score of every piece, own pieces positive,
+	in units of SCORE_UNIT centipawns, offset so it is linear over its own
+	127 wide slice of the range. the first layer copies the slices through and
+	the output adds up the side to move's and subtracts the opponent's.
+	the other neurons are left at zero for training to use.
+*/
+const int SCORE_UNIT = 4;  // centipawns per accumulator step
+const int SLICES = 16;     // covers +-SLICES / 2 * 127 * SCORE_UNIT centipawns
+
+int tableScore(int type, int square) {
+	int midgame = chess::pst::midgameValue[type] + chess::pst::midgame[type][square];
+	int endgame = chess::pst::endgameValue[type] + chess::pst::endgame[type][square];
+	return (midgame + endgame) / 2;
+}
+
+int roundedDivide(int value, int divisor) {
+	return value >= 0 ? (value + divisor / 2) / divisor : -((-value + divisor / 2) / divisor);
+}
+
+int main(int argc, const char** args) {
+	if (argc != 2) {
+		cerr << "usage: " << args[0] << " <network file>" << endl;
+		return 1;
+	}
+
+	vector<int16_t> featureWeights(chess::NNUE_INPUTS * chess::NNUE_HIDDEN, 0);
+	vector<int16_t> featureBias(chess::NNUE_HIDDEN, 0);
+	vector<int8_t> l1Weights(chess::NNUE_L1 * 2 * chess::NNUE_HIDDEN, 0);
+	vector<int32_t> l1Bias(chess::NNUE_L1, 0);
+	vector<int8_t> outputWeights(chess::NNUE_L1, 0);
+	int32_t outputBias = 0;
+
+	// inputs are seen from the side they belong to, so own pieces read the
+	// tables flipped like player 1's and the opponent's unflipped
+	for (int type = 0; type < 6; ++type) {
+		for (int square = 0; square < 64; ++square) {
+			int own = roundedDivide(tableScore(type, square ^ 56), SCORE_UNIT);
+			int opponent = -roundedDivide(tableScore(type, square), SCORE_UNIT);
+			for (int slice = 0; slice < SLICES; ++slice) {
+				featureWeights[(type * 64 + square) * chess::NNUE_HIDDEN + slice] = (int16_t) own;
+				featureWeights[((6 + type) * 64 + square) * chess::NNUE_HIDDEN + slice] = (int16_t) opponent;
+			}
+		}
+	}
+
+	for (int slice = 0; slice < SLICES; ++slice) {
+		featureBias[slice] = (int16_t) (127 * (SLICES / 2 - slice));
+		// copy each slice through unscaled, side to move and opponent
+		l1Weights[slice * 2 * chess::NNUE_HIDDEN + slice] = 1 << chess::NNUE_L1_SHIFT;
+		l1Weights[(SLICES + slice) * 2 * chess::NNUE_HIDDEN + chess::NNUE_HIDDEN + slice] = 1 << chess::NNUE_L1_SHIFT;
+		outputWeights[slice] = 1;
+		outputWeights[SLICES + slice] = -1;
+	}
+
+	// both sides count the score once, so the output is twice it
+	chess::NnueHeader header = { { 'N', 'N', 'U', 'E' }, chess::NNUE_VERSION, chess::NNUE_INPUTS, chess::NNUE_HIDDEN, chess::NNUE_L1,
+		SCORE_UNIT * chess::NNUE_OUTPUT_SCALE / 2 };
+	char headerBytes[chess::NNUE_HEADER_SIZE] = { };
+	memcpy(headerBytes, &header, sizeof(header));
+
+	ofstream file(args[1], ios::binary);
+	file.write(headerBytes, sizeof(headerBytes));
+	file.write((const char*) featureWeights.data(), featureWeights.size() * sizeof(int16_t));
+	file.write((const char*) featureBias.data(), featureBias.size() * sizeof(int16_t));
+	file.write((const char*) l1Weights.data(), l1Weights.size() * sizeof(int8_t));
+	file.write((const char*) l1Bias.data(), l1Bias.size() * sizeof(int32_t));
+	file.write((const char*) outputWeights.data(), outputWeights.size() * sizeof(int8_t));
+	file.write((const char*) &outputBias, sizeof(outputBias));
+	if (!file) {
+		cerr << "could not write " << args[1] << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,103 @@
+#ifndef __ORDERING_H_
+#define __ORDERING_H_
+
+#include <stdint.h>
+#include <cstring>
+
+namespace minimax {
+
+const int MAX_PLY = 64;
+
+/*
+	MoveOrdering
+	killer moves and history counters gathered while searching, used by move
+	iterators to try the moves most likely to cause a cutoff first.
+	transitions are identified by their packed form.
+*/
+struct MoveOrdering {
+	static const int HISTORY_SIZE = 1 << 12; // packed transitions are masked down to this
+	static const int HISTORY_MAX = 1 << 20;  // history is halved once any counter reaches this
+
+	bool enabled; // when off iterators return moves in generation order
+	uint16_t killers[MAX_PLY][2];
+	int32_t history[2][HISTORY_SIZE];
+
+	MoveOrdering() : enabled(true) {
+		clear();
+	}
+
+	void clear() {
+		memset(killers, 0, sizeof(killers));
+		memset(history, 0, sizeof(history));
+	}
+
+	/*
+		carries what was learned over to a search whose root is plies past the
+		last one's: killers move up to the ply they now belong to and history is
+		halved so the new position's cutoffs soon outweigh the old ones. a
+		negative plies is an unrelated position and drops the killers.
+	*/
+	void age(int plies) {
+		if (plies < 0 || plies >= MAX_PLY) {
+			memset(killers, 0, sizeof(killers));
+		} else if (plies > 0) {
+			memmove(killers, killers + plies, (MAX_PLY - plies) * sizeof(killers[0]));
+			memset(killers + MAX_PLY - plies, 0, plies * sizeof(killers[0]));
+		}
+		for (int i = 0; i < 2; ++i) {
+			for (int j = 0; j < HISTORY_SIZE; ++j)
+				history[i][j] /= 2;
+		}
+	}
+
+	// a quiet move caused a cutoff at ply
+	inline void addKiller(int ply, uint16_t move) {
+		if (killers[ply][0] != move) {
+			killers[ply][1] = killers[ply][0];
+			killers[ply][0] = move;
+		}
+	}
+
+	// 2 for the newest killer at ply, 1 for the older one, 0 otherwise
+	inline int getKiller(int ply, uint16_t move) const {
+		if (move == killers[ply][0])
+			return 2;
+		if (move == killers[ply][1])
+			return 1;
+		return 0;
+	}
+
+	inline void addHistory(int side, uint16_t move, int depth) {
+		int32_t& counter = history[side][move & (HISTORY_SIZE - 1)];
+		counter += depth * depth;
+		if (counter >= HISTORY_MAX) {
+			for (int i = 0; i < 2; ++i) {
+				for (int j = 0; j < HISTORY_SIZE; ++j)
+					history[i][j] /= 2;
+			}
+		}
+	}
+
+	inline int32_t getHistory(int side, uint16_t move) const {
+		return history[side][move & (HISTORY_SIZE - 1)];
+	}
+};
+
+/*
+	OrderingHints
+	what a node knows when it builds its move iterator
+*/
+struct OrderingHints {
+	const MoveOrdering* ordering; // null when there are no killers or history to use
+	int ply;                      // -1 when the ply is unknown, killers are skipped
+	int side;                     // index of the player to move
+	uint16_t hashMove;            // packed move to try first, 0 for none
+	bool noisyOnly;               // only moves that change the material balance, for quiescence search
+
+	OrderingHints(const MoveOrdering* ordering, int ply, int side, uint16_t hashMove, bool noisyOnly = false)
+		: ordering(ordering), ply(ply), side(side), hashMove(hashMove), noisyOnly(noisyOnly) { }
+};
+
+}
+
+#endif
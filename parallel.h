@@ -0,0 +1,165 @@
+#ifndef __PARALLEL_H_
+#define __PARALLEL_H_
+
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <ostream>
+#include "search.h"
+#include "transposition.h"
+
+namespace minimax {
+
+/*
+	ParallelSearch
+	lazy smp: every thread runs its own iterative deepening search of the same
+	position, sharing only the transposition table. helpers fill the table with
+	results the main thread then finds instead of searching, and the main
+	thread's move is the one played. helpers are stopped as soon as the main
+	thread finishes, so the limits only apply to the main thread.
+
+	AG - an abstract game
+*/
+template<class AG>
+struct ParallelSearch {
+	typedef typename AG::BoardType BoardType;
+	typedef typename AG::PlayerType PlayerType;
+	typedef typename AG::ScoreType ScoreType;
+	typedef typename AG::TransitionType TransitionType;
+
+	std::vector<SearchContext> contexts; // one per thread, contexts[0] is the main thread's
+	std::vector<std::unique_ptr<SearchStack<AG>>> stacks; // one per thread, kept from move to move
+	std::vector<uint64_t> threadNodes;   // nodes searched by each thread in the last search
+	std::vector<SearchStats> threadStats; // and what each of them did, when built with MINIMAX_STATS
+	std::function<void(const typename Search<AG>::Iteration&)> onIteration; // main thread only
+	SearchOptions options; // for every thread
+	const std::atomic<bool>* stop; // set from another thread to end the search early, checked by the main thread
+
+	uint64_t nodes;
+	uint64_t cutoffs;          // main thread only
+	uint64_t firstMoveCutoffs; // main thread only
+	uint64_t nullMoveCutoffs;  // main thread only
+	uint64_t reductions;       // main thread only
+	uint64_t reSearches;       // main thread only
+	uint64_t rootSearches;     // main thread only
+	uint64_t failLows;         // main thread only
+	uint64_t failHighs;        // main thread only
+	uint64_t tablebaseHits;    // main thread only
+	uint64_t futilityPrunes;   // main thread only
+	int completedDepth;
+
+	ParallelSearch(TranspositionTable* table, int threads) : contexts(threads < 1 ? 1 : threads, SearchContext(table)), threadNodes(contexts.size(), 0), threadStats(contexts.size()), stop(nullptr), nodes(0), cutoffs(0), firstMoveCutoffs(0), nullMoveCutoffs(0), reductions(0), reSearches(0), rootSearches(0), failLows(0), failHighs(0), tablebaseHits(0), futilityPrunes(0), completedDepth(0) {
+		for (int i = 0; i < getThreadCount(); ++i)
+			stacks.emplace_back(new SearchStack<AG>());
+	}
+
+	inline int getThreadCount() const {
+		return (int) contexts.size();
+	}
+
+	ScoreType iterate(BoardType* board, PlayerType player, const SearchLimits& limits, TransitionType& bestTransition) {
+		std::atomic<bool> stopHelpers(false);
+		std::vector<std::thread> helpers;
+
+		for (int i = 1; i < getThreadCount(); ++i) {
+			helpers.emplace_back([this, &stopHelpers, board, player, limits, i]() {
+				BoardType boardCopy = *board;
+				TransitionType trash;
+				SearchLimits helperLimits;
+				helperLimits.depth = limits.depth;
+
+				Search<AG> search(&contexts[i], stacks[i].get());
+				search.options = options;
+				search.stop = &stopHelpers;
+				search.threadIndex = i;
+				search.iterate(&boardCopy, player, helperLimits, trash);
+				threadNodes[i] = search.nodes;
+				if (SearchStats::ENABLED)
+					threadStats[i] = search.stats;
+			});
+		}
+
+		Search<AG> search(&contexts[0], stacks[0].get());
+		search.onIteration = onIteration;
+		search.options = options;
+		search.stop = stop;
+		ScoreType score = search.iterate(board, player, limits, bestTransition);
+		threadNodes[0] = search.nodes;
+		if (SearchStats::ENABLED)
+			threadStats[0] = search.stats;
+		cutoffs = search.cutoffs;
+		firstMoveCutoffs = search.firstMoveCutoffs;
+		nullMoveCutoffs = search.nullMoveCutoffs;
+		reductions = search.reductions;
+		reSearches = search.reSearches;
+		rootSearches = search.rootSearches;
+		failLows = search.failLows;
+		failHighs = search.failHighs;
+		tablebaseHits = search.tablebaseHits;
+		futilityPrunes = search.futilityPrunes;
+		completedDepth = search.completedDepth;
+
+		stopHelpers = true;
+		for (std::thread& helper : helpers)
+			helper.join();
+
+		nodes = 0;
+		for (uint64_t count : threadNodes)
+			nodes += count;
+		return score;
+	}
+
+	/*
+		gets ready for a search whose root is plies past the last one's,
+		negative when it isn't a continuation of the same game. the table and
+		every thread's move ordering are kept, only aged, so the search starts
+		warm.
+	*/
+	void newSearch(int plies) {
+		if (contexts[0].table)
+			contexts[0].table->newSearch();
+		for (SearchContext& context : contexts)
+			context.ordering.age(plies);
+	}
+
+	// forgets everything learned, for a new game
+	void clear() {
+		if (contexts[0].table)
+			contexts[0].table->clear();
+		for (SearchContext& context : contexts)
+			context.ordering.clear();
+	}
+
+	// transposition table counters summed over every thread
+	TranspositionTable::Counters getTableCounters() const {
+		TranspositionTable::Counters counters;
+		for (const SearchContext& context : contexts)
+			counters += context.tableCounters;
+		return counters;
+	}
+
+	// the last search's stats as json, every thread's and their sum
+	void writeStats(std::ostream& out) const {
+		SearchStats total;
+		out << "{\"threads\":[";
+		for (size_t i = 0; i < threadStats.size(); ++i) {
+			out << (i ? "," : "");
+			threadStats[i].writeJson(out);
+			total += threadStats[i];
+		}
+		out << "],\"total\":";
+		total.writeJson(out);
+		out << "}";
+	}
+
+	void resetCounters() {
+		for (SearchContext& context : contexts)
+			context.tableCounters.reset();
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,250 @@
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+#include "chessboard.h"
+
+using namespace std;
+
+/*
+	perft
+	counts the leaf nodes of the move tree to a fixed depth, the standard way
+	of checking a move generator for correctness and measuring its speed.
+	the last ply is counted straight from the move list rather than applied.
+*/
+uint64_t perft(chess::Board* board, chess::Player player, int depth) {
+	chess::MoveIterator moveIterator(board, player);
+	if (depth <= 1)
+		return depth == 1 ? moveIterator.moveCount : 1;
+
+	uint64_t nodes = 0;
+	for (int i = 0; i < moveIterator.moveCount; ++i) {
+		chess::Move move = moveIterator.getMove(i);
+		chess::Move::Undo undo;
+		move.apply(board, undo);
+		nodes += perft(board, -player, depth - 1);
+		move.revert(board, undo);
+	}
+	return nodes;
+}
+
+// perft split by the first move
+uint64_t divide(chess::Board* board, chess::Player player, int depth) {
+	chess::MoveIterator moveIterator(board, player);
+	uint64_t nodes = 0;
+	for (int i = 0; i < moveIterator.moveCount; ++i) {
+		chess::Move move = moveIterator.getMove(i);
+		chess::Move::Undo undo;
+		move.apply(board, undo);
+		uint64_t count = perft(board, -player, depth - 1);
+		move.revert(board, undo);
+
+		cout << move.toCoordinate() << ": " << count << endl;
+		nodes += count;
+	}
+	return nodes;
+}
+
+/*
+	plays a list of coordinate moves from the board's position,
+	returns the player to move or 0 if a move isn't possible
+*/
+chess::Player playMoves(chess::Board* board, chess::Player player, const char* const* moves, int count) {
+	for (int i = 0; i < count; ++i) {
+		chess::Move move;
+		if (!chess::parseMove(board, player, moves[i], move)) {
+			cerr << "illegal move: " << moves[i] << endl;
+			return 0;
+		}
+		chess::Move::Undo undo;
+		move.apply(board, undo);
+		player = -player;
+	}
+	return player;
+}
+
+inline double secondsSince(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/*
+	bench
+	fixed positions with the node counts the generator must reproduce. the
+	start position's and the ones given by fen are the published perft
+	numbers, the fen ones pile up castling, en passant, promotion and pins.
+*/
+struct BenchPosition {
+	const char* name;
+	const char* fen; // null for the start position
+	const char* moves[12];
+	int moveCount;
+	int depth;
+	uint64_t nodes;
+};
+
+const BenchPosition BENCH_POSITIONS[] = {
+	{ "start", nullptr, { }, 0, 5, 4865609ULL },
+	{ "two knights", nullptr, { "e2e4", "e7e5", "g1f3", "b8c6", "f1c4", "g8f6" }, 6, 5, 30293344ULL },
+	{ "queen's gambit declined", nullptr, { "d2d4", "d7d5", "c2c4", "e7e6", "b1c3", "g8f6", "c1g5", "f8e7" }, 8, 5, 54432701ULL },
+	{ "najdorf", nullptr, { "e2e4", "c7c5", "g1f3", "d7d6", "d2d4", "c5d4", "f3d4", "g8f6", "b1c3", "a7a6" }, 10, 5, 68542976ULL },
+	{ "scandinavian", nullptr, { "e2e4", "d7d5", "e4d5", "d8d5", "b1c3", "d5a5" }, 6, 5, 43910369ULL },
+	{ "alekhine en passant", nullptr, { "e2e4", "g8f6", "e4e5", "d7d5" }, 4, 5, 25799404ULL },
+	{ "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", { }, 0, 4, 4085603ULL },
+	{ "rook endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", { }, 0, 5, 674624ULL },
+	{ "promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", { }, 0, 4, 422333ULL },
+	{ "underpromotion", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", { }, 0, 4, 2103487ULL },
+	{ "symmetrical", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", { }, 0, 4, 3894594ULL },
+};
+
+// returns the player to move or 0 if the fen or a move is wrong
+chess::Player setUp(const BenchPosition& position, chess::Board* board) {
+	chess::Player player = 1;
+	if (position.fen && !chess::parseFen(position.fen, board, player)) {
+		cerr << "invalid fen: " << position.fen << endl;
+		return 0;
+	}
+	return playMoves(board, player, position.moves, position.moveCount);
+}
+
+int bench() {
+	uint64_t totalNodes = 0;
+	double totalSeconds = 0;
+	int failures = 0;
+
+	for (const BenchPosition& position : BENCH_POSITIONS) {
+		chess::Board board;
+		chess::Player player = setUp(position, &board);
+		if (player == 0)
+			return 1;
+
+		auto start = chrono::steady_clock::now();
+		uint64_t nodes = perft(&board, player, position.depth);
+		double seconds = secondsSince(start);
+
+		bool ok = nodes == position.nodes;
+		failures += !ok;
+		totalNodes += nodes;
+		totalSeconds += seconds;
+
+		cout << (ok ? "ok   " : "FAIL ") << position.name
+			<< " depth " << position.depth
+			<< " nodes " << nodes;
+		if (!ok)
+			cout << " expected " << position.nodes;
+		cout << " nps " << (uint64_t) (nodes / seconds) << endl;
+	}
+
+	cout << "total nodes " << totalNodes
+		<< " time " << (int) (totalSeconds * 1000) << "ms"
+		<< " nps " << (uint64_t) (totalNodes / totalSeconds) << endl;
+	return failures ? 1 : 0;
+}
+
+/*
+	evalbench
+	walks the move tree of the bench positions scoring every leaf, once per
+	evaluator, and reports leaves per second against a walk that scores
+	nothing. the network walk includes keeping the accumulator up to date.
+*/
+enum Evaluator { EVALUATE_NONE, EVALUATE_MATERIAL, EVALUATE_TAPERED, EVALUATE_NETWORK };
+
+int64_t evaluateTree(chess::Board* board, chess::Player player, int depth, Evaluator evaluator, uint64_t& leaves) {
+	if (depth == 0) {
+		leaves++;
+		switch (evaluator) {
+			case EVALUATE_MATERIAL:
+				return board->getScore() * player;
+			case EVALUATE_TAPERED:
+				return board->getTaperedScore() * player;
+			case EVALUATE_NETWORK:
+				return board->getNetworkScore(player);
+			default:
+				return 0;
+		}
+	}
+
+	chess::MoveIterator moveIterator(board, player);
+	int64_t sum = 0;
+	for (int i = 0; i < moveIterator.moveCount; ++i) {
+		chess::Move move = moveIterator.getMove(i);
+		chess::Move::Undo undo;
+		move.apply(board, undo);
+		sum += evaluateTree(board, -player, depth - 1, evaluator, leaves);
+		move.revert(board, undo);
+	}
+	return sum;
+}
+
+int evalBench(const char* networkPath) {
+	const char* names[] = { "none", "material", "tapered", "network" };
+	double baseline = 0;
+	for (int evaluator = EVALUATE_NONE; evaluator <= EVALUATE_NETWORK; ++evaluator) {
+		// boards have to be built after the network is loaded to start with a valid accumulator
+		if (evaluator == EVALUATE_NETWORK && !chess::nnueLoad(networkPath)) {
+			cerr << "could not load network " << networkPath << endl;
+			return 1;
+		}
+
+		uint64_t leaves = 0;
+		int64_t checksum = 0;
+		auto start = chrono::steady_clock::now();
+		for (const BenchPosition& position : BENCH_POSITIONS) {
+			chess::Board board;
+			chess::Player player = setUp(position, &board);
+			if (player == 0)
+				return 1;
+			checksum += evaluateTree(&board, player, position.depth - 1, (Evaluator) evaluator, leaves);
+		}
+		double seconds = secondsSince(start);
+		if (evaluator == EVALUATE_NONE)
+			baseline = seconds;
+
+		cout << names[evaluator]
+			<< " leaves " << leaves
+			<< " time " << (int) (seconds * 1000) << "ms"
+			<< " leaves/s " << (uint64_t) (leaves / seconds);
+		if (evaluator != EVALUATE_NONE && seconds > baseline)
+			cout << " evals/s " << (uint64_t) (leaves / (seconds - baseline));
+		cout << " mean " << (double) checksum / leaves << endl;
+	}
+	return 0;
+}
+
+int main(int argc, const char** args) {
+	if (argc >= 2 && strcmp(args[1], "bench") == 0)
+		return bench();
+	if (argc >= 3 && strcmp(args[1], "evalbench") == 0)
+		return evalBench(args[2]);
+
+	if (argc < 2) {
+		cerr << "usage: " << args[0] << " <depth> [-fen <fen>] [moves...]" << endl;
+		cerr << "       " << args[0] << " bench" << endl;
+		cerr << "       " << args[0] << " evalbench <network file>" << endl;
+		return 1;
+	}
+
+	int depth = atoi(args[1]);
+	chess::Board board;
+	chess::Player player = 1;
+	int first = 2;
+	if (argc >= 4 && strcmp(args[2], "-fen") == 0) {
+		if (!chess::parseFen(args[3], &board, player)) {
+			cerr << "invalid fen: " << args[3] << endl;
+			return 1;
+		}
+		first = 4;
+	}
+	player = playMoves(&board, player, args + first, argc - first);
+	if (player == 0 || depth < 1)
+		return 1;
+
+	auto start = chrono::steady_clock::now();
+	uint64_t nodes = divide(&board, player, depth);
+	double seconds = secondsSince(start);
+
+	cout << endl << "nodes " << nodes
+		<< " time " << (int) (seconds * 1000) << "ms"
+		<< " nps " << (uint64_t) (nodes / seconds) << endl;
+	return 0;
+}
@@ -0,0 +1,451 @@
+#ifndef __SEARCH_H_
+#define __SEARCH_H_
+
+#include <stdint.h>
+#include <limits>
+#include <chrono>
+#include <functional>
+#include <atomic>
+#include "minimax.h"
+#include "transposition.h"
+#include "ordering.h"
+#include "stats.h"
+
+namespace minimax {
+
+/*
+	SearchLimits
+	when to stop an iterative deepening search, 0 means no limit
+*/
+struct SearchLimits {
+	int depth;
+	int64_t milliseconds;
+	uint64_t nodes;
+
+	SearchLimits() : depth(0), milliseconds(0), nodes(0) { }
+};
+
+/*
+	SearchOptions
+	switches for the selective parts of the search, so each can be compared
+	against the search without it
+*/
+struct SearchOptions {
+	bool nullMove;           // let the opponent move twice, if that still fails high so will a real move
+	bool lateMoveReductions; // search quiet moves late in the ordering less deeply
+	bool futility;           // skip quiet moves near the horizon that can't bring the score up to alpha
+	bool reverseFutility;    // stop near the horizon when the static score is far above beta
+	bool aspiration;         // search the root with a window around the last iteration's score
+	int aspirationWindow;    // half width of the first window, 0 for the heuristic's FUTILITY_MARGIN
+
+	SearchOptions() : nullMove(true), lateMoveReductions(true), futility(true), reverseFutility(true), aspiration(true), aspirationWindow(0) { }
+};
+
+/*
+	Search
+	runtime depth counterpart to Minimax, a principal variation search in negamax
+	form so every score is from the perspective of the player to move. iterate runs iterative deepening until
+	the limits are hit and returns the result of the last completed iteration.
+
+	AG - an abstract game
+*/
+template<class AG>
+struct Search {
+	typedef typename AG::BoardType BoardType;
+	typedef typename AG::PlayerType PlayerType;
+	typedef typename AG::ScoreType ScoreType;
+	typedef typename AG::TransitionType TransitionType;
+	typedef std::chrono::steady_clock Clock;
+
+	static const uint64_t CHECK_INTERVAL = 1024; // nodes between looking at the clock
+
+	static const int NULL_MOVE_MIN_DEPTH = 3;
+	static const int NULL_MOVE_VERIFY_DEPTH = 6;  // deeper null move cutoffs are confirmed by a reduced search
+	static const int FUTILITY_MAX_DEPTH = 3;
+	static const int LATE_MOVE_MIN_DEPTH = 3;
+	static const int LATE_MOVE_MIN_INDEX = 3;     // the first few moves are always searched fully
+	static const int ASPIRATION_MIN_DEPTH = 4;    // shallower scores are too unsettled to aim at
+
+	static constexpr ScoreType SCORE_INFINITE = std::numeric_limits<ScoreType>::max();
+
+	// reported after every completed iteration
+	struct Iteration {
+		int depth;
+		ScoreType score;
+		uint64_t nodes;
+		int64_t milliseconds;
+		const TransitionType* pv;
+		int pvLength;
+	};
+
+	SearchContext* context;
+	SearchStack<AG>* stack; // frames for every ply, the thread's local stack when null
+	SearchOptions options;
+	std::function<void(const Iteration&)> onIteration;
+
+	const std::atomic<bool>* stop; // set from another thread to end the search early
+	int threadIndex;               // 0 for the main thread, helpers may stop before depth 1 completes
+
+	uint64_t nodes;
+	uint64_t cutoffs;
+	uint64_t firstMoveCutoffs; // cutoffs caused by the first move tried, a measure of ordering quality
+	uint64_t nullMoveCutoffs;
+	uint64_t reductions;       // late moves searched to a reduced depth
+	uint64_t reSearches;       // reduced moves that beat alpha and were searched again
+	uint64_t futilityPrunes;   // moves and nodes skipped by either futility test
+	uint64_t rootSearches;     // searches of the root, more than one per iteration when a window fails
+	uint64_t failLows;         // root searches that scored below the aspiration window
+	uint64_t failHighs;        // and above it
+	uint64_t tablebaseHits;    // nodes scored from the endgame tables instead of searched
+	int completedDepth;
+	SearchStats stats;         // only counted when built with MINIMAX_STATS
+
+	Search(SearchContext* context, SearchStack<AG>* stack = nullptr) : context(context), stack(stack), stop(nullptr), threadIndex(0), nodes(0), cutoffs(0), firstMoveCutoffs(0), nullMoveCutoffs(0), reductions(0), reSearches(0), futilityPrunes(0), rootSearches(0), failLows(0), failHighs(0), tablebaseHits(0), completedDepth(0), aborted(false) {
+		static_assert(std::is_base_of<AbstractGameBaseClass, AG>::value, "template parameter AG must be a template specialization of AbstractGame.");
+	}
+
+	/*
+		the board is searched in place and left as it was found, even when the
+		search is stopped early. killers and history carry over from the
+		context's last search, age or clear them in between.
+	*/
+	ScoreType iterate(BoardType* board, PlayerType player, const SearchLimits& searchLimits, TransitionType& bestTransition) {
+		if (!stack)
+			stack = &SearchStack<AG>::local();
+
+		limits = searchLimits;
+		if (limits.depth <= 0 || limits.depth >= MAX_PLY)
+			limits.depth = MAX_PLY - 1;
+		start = Clock::now();
+		nodes = cutoffs = firstMoveCutoffs = 0;
+		nullMoveCutoffs = reductions = reSearches = futilityPrunes = 0;
+		rootSearches = failLows = failHighs = tablebaseHits = 0;
+		completedDepth = 0;
+		stats.clear();
+		aborted = false;
+		previousPvLength = 0;
+
+		// odd helper threads start a ply deeper so threads spread over more depths
+		ScoreType bestScore = 0;
+		for (int depth = 1 + (threadIndex & 1); depth <= limits.depth; ++depth) {
+			ScoreType score = runRoot(board, player, depth, bestScore);
+			if (aborted)
+				break;
+
+			completedDepth = depth;
+			if (SearchStats::ENABLED)
+				stats.iteration(depth, nodes, std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+			bestScore = score;
+			bestTransition = pvLength[0] ? pv[0][0] : TransitionType();
+
+			previousPvLength = pvLength[0];
+			for (int i = 0; i < previousPvLength; ++i)
+				previousPv[i] = pv[0][i];
+
+			if (onIteration) {
+				Iteration iteration = { depth, score, nodes, elapsed(), previousPv, previousPvLength };
+				onIteration(iteration);
+			}
+
+			// the next iteration would take several times as long as this one, don't start it
+			if (limits.milliseconds && elapsed() * 2 >= limits.milliseconds)
+				break;
+		}
+
+		return bestScore;
+	}
+
+	inline int64_t elapsed() const {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+	}
+
+private:
+	SearchLimits limits;
+	Clock::time_point start;
+	bool aborted;
+
+	// triangular principal variation table, pv[ply] is the line below ply
+	TransitionType pv[MAX_PLY][MAX_PLY];
+	int pvLength[MAX_PLY];
+
+	// principal variation of the last completed iteration, used as the hash move along it
+	TransitionType previousPv[MAX_PLY];
+	int previousPvLength;
+	bool followPv;
+
+	/*
+		searches the root to depth, starting with a narrow window around the
+		expected score and widening whichever side fails until the score lands
+		inside it
+	*/
+	ScoreType runRoot(BoardType* board, PlayerType player, int depth, ScoreType expected) {
+		int64_t window = options.aspirationWindow > 0 ? options.aspirationWindow : AG::HeuristicType::FUTILITY_MARGIN;
+		if (window < 1)
+			window = 1;
+		const bool aspiration = options.aspiration && depth >= ASPIRATION_MIN_DEPTH;
+		ScoreType alpha = aspiration ? clampScore((int64_t) expected - window) : -SCORE_INFINITE;
+		ScoreType beta = aspiration ? clampScore((int64_t) expected + window) : SCORE_INFINITE;
+
+		while (true) {
+			followPv = true;
+			rootSearches++;
+			ScoreType score = run(board, player, depth, 0, alpha, beta);
+			if (aborted)
+				return score;
+
+			if (score <= alpha && alpha > -SCORE_INFINITE) {
+				failLows++;
+				alpha = clampScore((int64_t) score - window);
+			} else if (score >= beta && beta < SCORE_INFINITE) {
+				failHighs++;
+				beta = clampScore((int64_t) score + window);
+			} else {
+				return score;
+			}
+			window *= 4;
+		}
+	}
+
+	static inline ScoreType clampScore(int64_t score) {
+		if (score <= -(int64_t) SCORE_INFINITE)
+			return -SCORE_INFINITE;
+		if (score >= (int64_t) SCORE_INFINITE)
+			return SCORE_INFINITE;
+		return (ScoreType) score;
+	}
+
+	inline void checkLimits() {
+		// the first iteration always completes so there is a move to return
+		if (completedDepth == 0 && threadIndex == 0)
+			return;
+		if (stop && stop->load(std::memory_order_relaxed)) {
+			aborted = true;
+			return;
+		}
+		if (limits.nodes && nodes >= limits.nodes)
+			aborted = true;
+		else if (limits.milliseconds && (nodes % CHECK_INTERVAL) == 0 && elapsed() >= limits.milliseconds)
+			aborted = true;
+	}
+
+	// counts quiescence nodes and stops it with the rest of the search
+	struct QuiescenceVisitor {
+		Search* search;
+
+		inline void visit() {
+			search->nodes++;
+			search->stats.quiescenceNode();
+			search->stats.evaluation(); // quiescence always stands pat
+			search->checkLimits();
+		}
+
+		inline bool aborted() const {
+			return search->aborted;
+		}
+	};
+
+	/*
+		allowNull is false straight after a null move, two in a row prove nothing
+	*/
+	ScoreType run(BoardType* board, PlayerType player, int depth, int ply, ScoreType alpha, ScoreType beta, bool allowNull = true) {
+		pvLength[ply] = ply;
+		if (depth <= 0) {
+			QuiescenceVisitor visitor = { this };
+			return Quiescence<AG>::run(visitor, *stack, board, player, ply, alpha, beta);
+		}
+
+		nodes++;
+		stats.node();
+		checkLimits();
+		if (aborted)
+			return 0;
+
+		if (ply >= MAX_PLY - 1) {
+			stats.evaluation();
+			return AG::HeuristicType::getScore(board, player);
+		}
+
+		// the root still has to pick a move
+		ScoreType tablebaseScore;
+		if (ply > 0 && AG::HeuristicType::probeTablebase(board, player, ply, tablebaseScore)) {
+			tablebaseHits++;
+			return tablebaseScore;
+		}
+
+		TranspositionTable* table = context ? context->table : nullptr;
+		uint64_t hash = 0;
+		uint16_t hashMove = 0;
+		if (table) {
+			hash = board->getHash() ^ player.getHash();
+
+			TranspositionTable::Entry entry;
+			if (table->probe(hash, entry, context->tableCounters)) {
+				hashMove = entry.move;
+				entry.score = TranspositionTable::fromTableScore(entry.score, ply, AG::HeuristicType::SCORE_MATE);
+				const bool cutoff = ply > 0 && entry.depth >= depth && (entry.bound == TranspositionTable::BOUND_EXACT ||
+					(entry.bound == TranspositionTable::BOUND_LOWER && entry.score >= beta) ||
+					(entry.bound == TranspositionTable::BOUND_UPPER && entry.score <= alpha));
+				stats.tableHit(cutoff);
+				if (cutoff)
+					return entry.score;
+			}
+		}
+
+		// on the previous iteration's principal variation its move goes first
+		if (followPv) {
+			if (ply < previousPvLength)
+				hashMove = previousPv[ply].pack();
+			else
+				followPv = false;
+		}
+
+		PlayerType nextPlayer = player.getOpponent();
+		typename SearchStack<AG>::Frame& frame = (*stack)[ply];
+
+		// selective search, only away from the principal variation and never in check
+		const bool pvNode = alpha + 1 < beta; // not beta - alpha, which overflows on a full window
+		const bool inCheck = AG::HeuristicType::isInCheck(board, player);
+		const ScoreType staticScore = AG::HeuristicType::getScore(board, player);
+		stats.evaluation();
+		const ScoreType margin = AG::HeuristicType::FUTILITY_MARGIN * depth;
+		const bool selective = ply > 0 && !pvNode && !inCheck;
+
+		if (selective && options.reverseFutility && depth <= FUTILITY_MAX_DEPTH && staticScore - margin >= beta) {
+			futilityPrunes++;
+			return staticScore - margin;
+		}
+
+		if (selective && options.nullMove && allowNull && depth >= NULL_MOVE_MIN_DEPTH && staticScore >= beta
+				&& AG::HeuristicType::allowNullMove(board, player)) {
+			const int reduction = depth >= 6 ? 3 : 2;
+			TransitionType::applyNull(board, frame.undo);
+			ScoreType score = -run(board, nextPlayer, depth - 1 - reduction, ply + 1, -beta, -beta + 1, false);
+			TransitionType::revertNull(board, frame.undo);
+			if (aborted)
+				return 0;
+
+			// confirm deep cutoffs without a null move, in case of zugzwang
+			if (score >= beta && depth >= NULL_MOVE_VERIFY_DEPTH) {
+				score = run(board, player, depth - reduction, ply, beta - 1, beta, false);
+				pvLength[ply] = ply;
+				if (aborted)
+					return 0;
+			}
+			if (score >= beta) {
+				nullMoveCutoffs++;
+				return beta;
+			}
+		}
+
+		const bool futile = selective && options.futility && depth <= FUTILITY_MAX_DEPTH && staticScore + margin <= alpha;
+
+		const ScoreType alphaOriginal = alpha;
+		ScoreType best = -SCORE_INFINITE;
+		TransitionType bestTransition;
+
+		MoveOrdering* ordering = context ? &context->ordering : nullptr;
+		typename AG::IteratorType& moveIterator = frame.makeIterator(board, player, OrderingHints(ordering, ply, player.getIndex(), hashMove));
+		TransitionType& transition = frame.transition;
+		int moveIndex = 0;
+
+		// principal variation search, only the first move gets the full window
+		while (moveIterator.getNext(transition)) {
+			const bool quiet = !transition.isNoisy(board);
+			transition.apply(board, frame.undo);
+
+			// quiet moves that don't check can be skipped or reduced, the first move never is
+			const bool lateQuiet = moveIndex > 0 && quiet && !inCheck && !AG::HeuristicType::isInCheck(board, nextPlayer);
+			if (futile && lateQuiet) {
+				transition.revert(board, frame.undo);
+				futilityPrunes++;
+				moveIndex++;
+				continue;
+			}
+
+			int reduction = 0;
+			if (options.lateMoveReductions && lateQuiet && !pvNode && depth >= LATE_MOVE_MIN_DEPTH && moveIndex >= LATE_MOVE_MIN_INDEX
+					&& !(ordering && ordering->getKiller(ply, transition.pack()))) {
+				reduction = moveIndex >= 2 * LATE_MOVE_MIN_INDEX ? 2 : 1;
+				// a move that has cut off at this depth before is trusted a little more
+				if (ordering && ordering->getHistory(player.getIndex(), transition.pack()) >= depth * depth)
+					reduction--;
+				if (reduction > depth - 2)
+					reduction = depth - 2;
+			}
+
+			ScoreType score = 0;
+			if (moveIndex == 0) {
+				score = -run(board, nextPlayer, depth - 1, ply + 1, -beta, -alpha);
+			} else {
+				if (reduction > 0) {
+					reductions++;
+					score = -run(board, nextPlayer, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+					if (score > alpha && !aborted)
+						reSearches++;
+				}
+				if (reduction == 0 || (score > alpha && !aborted))
+					score = -run(board, nextPlayer, depth - 1, ply + 1, -alpha - 1, -alpha);
+				if (score > alpha && score < beta && !aborted)
+					score = -run(board, nextPlayer, depth - 1, ply + 1, -beta, -alpha);
+			}
+			transition.revert(board, frame.undo);
+			followPv = false;
+
+			if (aborted)
+				return 0;
+
+			if (score > best) {
+				best = score;
+				bestTransition = transition;
+
+				if (score > alpha) {
+					alpha = score;
+
+					pv[ply][ply] = transition;
+					for (int i = ply + 1; i < pvLength[ply + 1]; ++i)
+						pv[ply][i] = pv[ply + 1][i];
+					pvLength[ply] = pvLength[ply + 1];
+				}
+			}
+
+			if (alpha >= beta) {
+				cutoffs++;
+				stats.cutoff(moveIndex);
+				if (moveIndex == 0)
+					firstMoveCutoffs++;
+				if (ordering && quiet) {
+					ordering->addKiller(ply, transition.pack());
+					ordering->addHistory(player.getIndex(), transition.pack(), depth);
+				}
+				break;
+			}
+
+			moveIndex++;
+		}
+
+		// nothing to play, the game is over
+		if (bestTransition.isNull())
+			return AG::HeuristicType::getTerminalScore(board, player, ply);
+
+		// root cutoffs still need a move to report
+		if (ply == 0 && pvLength[0] == 0) {
+			pv[0][0] = bestTransition;
+			pvLength[0] = 1;
+		}
+
+		if (table) {
+			TranspositionTable::Bound bound = TranspositionTable::BOUND_EXACT;
+			if (best <= alphaOriginal)
+				bound = TranspositionTable::BOUND_UPPER;
+			else if (best >= beta)
+				bound = TranspositionTable::BOUND_LOWER;
+			table->store(hash, bestTransition.pack(), TranspositionTable::toTableScore(best, ply, AG::HeuristicType::SCORE_MATE), depth, bound, context->tableCounters);
+		}
+
+		return best;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef __STATS_H_
+#define __STATS_H_
+
+#include <stdint.h>
+#include <cstring>
+#include <ostream>
+#include "ordering.h"
+
+/*
+	built with -DMINIMAX_STATS=1 (make stats) the runtime search counts what
+	every node does into SearchStats. otherwise every counter is behind a
+	constant false and compiles away, so the search pays nothing for it.
+*/
+#ifndef MINIMAX_STATS
+#define MINIMAX_STATS 0
+#endif
+
+namespace minimax {
+
+/*
+	SearchStats
+	what one thread's search did, for tuning ordering and pruning:
+		- nodes of the main search and of quiescence, and static evaluations
+		- cutoffs by the index of the move that caused them, the last slot
+		  counts every later move
+		- transposition table hits and the ones that ended the node
+		- nodes, quiescence included, and time for each completed iteration
+*/
+struct SearchStats {
+	static const bool ENABLED = MINIMAX_STATS != 0;
+	static const int CUTOFF_INDEXES = 8;
+
+	uint64_t nodes;
+	uint64_t quiescenceNodes;
+	uint64_t evaluations;
+	uint64_t tableHits;
+	uint64_t tableCutoffs;
+	uint64_t cutoffs[CUTOFF_INDEXES];
+	int depths; // iterations completed
+	uint64_t depthNodes[MAX_PLY]; // nodes searched by each iteration alone, depthNodes[0] is depth 1
+	int64_t depthMicroseconds[MAX_PLY];
+
+	SearchStats() {
+		clear();
+	}
+
+	void clear() {
+		memset(this, 0, sizeof(*this));
+	}
+
+	inline void node() {
+		if (ENABLED)
+			nodes++;
+	}
+
+	inline void quiescenceNode() {
+		if (ENABLED)
+			quiescenceNodes++;
+	}
+
+	inline void evaluation() {
+		if (ENABLED)
+			evaluations++;
+	}
+
+	inline void tableHit(bool cutoff) {
+		if (ENABLED) {
+			tableHits++;
+			tableCutoffs += cutoff;
+		}
+	}
+
+	inline void cutoff(int moveIndex) {
+		if (ENABLED)
+			cutoffs[moveIndex < CUTOFF_INDEXES ? moveIndex : CUTOFF_INDEXES - 1]++;
+	}
+
+	// an iteration finished, totals are for the whole search so far
+	inline void iteration(int depth, uint64_t totalNodes, int64_t totalMicroseconds) {
+		if (!ENABLED || depth > MAX_PLY)
+			return;
+		uint64_t previousNodes = 0;
+		int64_t previousMicroseconds = 0;
+		for (int i = 0; i < depths; ++i) {
+			previousNodes += depthNodes[i];
+			previousMicroseconds += depthMicroseconds[i];
+		}
+		// helper threads skip depths, those are left empty
+		for (; depths < depth; ++depths)
+			depthNodes[depths] = depthMicroseconds[depths] = 0;
+		depthNodes[depth - 1] = totalNodes - previousNodes;
+		depthMicroseconds[depth - 1] = totalMicroseconds - previousMicroseconds;
+	}
+
+	SearchStats& operator+=(const SearchStats& other) {
+		nodes += other.nodes;
+		quiescenceNodes += other.quiescenceNodes;
+		evaluations += other.evaluations;
+		tableHits += other.tableHits;
+		tableCutoffs += other.tableCutoffs;
+		for (int i = 0; i < CUTOFF_INDEXES; ++i)
+			cutoffs[i] += other.cutoffs[i];
+		for (int i = 0; i < other.depths; ++i) {
+			depthNodes[i] += other.depthNodes[i];
+			depthMicroseconds[i] += other.depthMicroseconds[i];
+		}
+		if (other.depths > depths)
+			depths = other.depths;
+		return *this;
+	}
+
+	// nodes per node of the iteration before, from depth 2 on
+	double getBranchingFactor(int depth) const {
+		if (depth < 2 || depth > depths || depthNodes[depth - 2] == 0)
+			return 0;
+		return (double) depthNodes[depth - 1] / depthNodes[depth - 2];
+	}
+
+	void writeJson(std::ostream& out) const {
+		uint64_t totalCutoffs = 0;
+		for (int i = 0; i < CUTOFF_INDEXES; ++i)
+			totalCutoffs += cutoffs[i];
+
+		out << "{\"nodes\":" << nodes
+			<< ",\"quiescenceNodes\":" << quiescenceNodes
+			<< ",\"evaluations\":" << evaluations
+			<< ",\"tableHits\":" << tableHits
+			<< ",\"tableCutoffs\":" << tableCutoffs
+			<< ",\"cutoffs\":" << totalCutoffs
+			<< ",\"firstMoveCutoffRate\":" << (totalCutoffs ? (double) cutoffs[0] / totalCutoffs : 0)
+			<< ",\"cutoffsByMoveIndex\":[";
+		for (int i = 0; i < CUTOFF_INDEXES; ++i)
+			out << (i ? "," : "") << cutoffs[i];
+		out << "],\"depths\":[";
+		for (int i = 0; i < depths; ++i) {
+			out << (i ? "," : "") << "{\"depth\":" << i + 1
+				<< ",\"nodes\":" << depthNodes[i]
+				<< ",\"microseconds\":" << depthMicroseconds[i]
+				<< ",\"branchingFactor\":" << getBranchingFactor(i + 1) << "}";
+		}
+		out << "]}";
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,97 @@
+#include "tablebase.h"
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace chess {
+
+Tablebases tablebases;
+
+const char* tablebaseName(int ending) {
+	switch (ending) {
+		case TABLEBASE_KQK:
+			return "kqk";
+		case TABLEBASE_KRK:
+			return "krk";
+		case TABLEBASE_KPK:
+			return "kpk";
+		default:
+			return "";
+	}
+}
+
+int tablebaseIndex(const Board* board, Player player, size_t& index) {
+	const Bitboard occupied = board->getOccupied();
+	const int count = bitboardCount(occupied);
+	if (count > 3 || board->castling != 0)
+		return TABLEBASE_NONE;
+	if (count == 2)
+		return TABLEBASE_DRAWN;
+
+	int square = bitboardFirst(occupied & ~board->byType[PIECE_KING]);
+	const Piece piece = board->getPieceAt(square);
+	int ending;
+	switch (piece < 0 ? -piece : piece) {
+		case PIECE_QUEEN:
+			ending = TABLEBASE_KQK;
+			break;
+		case PIECE_ROOK:
+			ending = TABLEBASE_KRK;
+			break;
+		case PIECE_PAWN:
+			ending = TABLEBASE_KPK;
+			break;
+		default:
+			return TABLEBASE_DRAWN;
+	}
+
+	// flip the board so the piece belongs to player 1
+	int strongKing = board->getKing(1);
+	int weakKing = board->getKing(-1);
+	if (piece < 0) {
+		const int king = strongKing;
+		strongKing = weakKing ^ 56;
+		weakKing = king ^ 56;
+		square ^= 56;
+		player = -player;
+	}
+
+	index = (((size_t) (player < 0) * 64 + strongKing) * 64 + weakKing) * 64 + square;
+	return ending;
+}
+
+int Tablebases::open(const char* directory) {
+	close();
+
+	int loaded = 0;
+	for (int ending = 0; ending < TABLEBASE_ENDINGS; ++ending) {
+		const std::string path = std::string(directory) + "/" + tablebaseName(ending) + ".tb";
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			continue;
+
+		struct stat info;
+		void* mapping = MAP_FAILED;
+		if (fstat(fd, &info) == 0 && (size_t) info.st_size == TABLEBASE_SIZE)
+			mapping = mmap(nullptr, TABLEBASE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+
+		if (mapping != MAP_FAILED) {
+			tables[ending] = (const uint8_t*) mapping;
+			loaded++;
+		}
+	}
+	return loaded;
+}
+
+void Tablebases::close() {
+	for (int i = 0; i < TABLEBASE_ENDINGS; ++i) {
+		if (tables[i])
+			munmap((void*) tables[i], TABLEBASE_SIZE);
+		tables[i] = nullptr;
+	}
+}
+
+}
@@ -0,0 +1,95 @@
+#ifndef __TABLEBASE_H_
+#define __TABLEBASE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "chessboard.h"
+
+namespace chess {
+
+/*
+	endgame tablebases
+	the exact result of every position of a few three piece endings, worked
+	out backwards from the mates by tbgen. one file per ending, one byte per
+	position:
+		0        draw, or a position that can't occur
+		n > 0    mate in n - 1 plies with best play, won by the side to move
+		         when n - 1 is odd and lost when it is even
+	positions are stored with the side that has the extra piece as player 1,
+	indexed by tablebaseIndex.
+	two kings alone and a king and minor piece against a king are known draws
+	and need no file.
+*/
+enum TablebaseEnding {
+	TABLEBASE_KQK,
+	TABLEBASE_KRK,
+	TABLEBASE_KPK,
+	TABLEBASE_ENDINGS,
+	TABLEBASE_DRAWN = TABLEBASE_ENDINGS, // no mating material
+	TABLEBASE_NONE                       // not covered
+};
+
+const size_t TABLEBASE_SIZE = 2 * 64 * 64 * 64; // side to move, strong king, weak king, piece
+
+const char* tablebaseName(int ending); // "kqk", also the file name without ".tb"
+
+/*
+	the ending the position belongs to and, for one with a file, its index in
+	that file. castling rights have to be gone, the tables don't know them.
+*/
+int tablebaseIndex(const Board* board, Player player, size_t& index);
+
+struct TablebaseResult {
+	int result; // 1 the side to move wins, -1 it loses, 0 draw
+	int plies;  // to mate, 0 for draws
+};
+
+/*
+	Tablebases
+	the files of a directory mapped shared and read only, so concurrent engine
+	processes probe one copy
+*/
+struct Tablebases {
+	Tablebases() {
+		for (int i = 0; i < TABLEBASE_ENDINGS; ++i)
+			tables[i] = nullptr;
+	}
+
+	~Tablebases() {
+		close();
+	}
+
+	Tablebases(const Tablebases&) = delete;
+	Tablebases& operator=(const Tablebases&) = delete;
+
+	// maps every file found in directory, returns how many were
+	int open(const char* directory);
+	void close();
+
+	// false when the position isn't covered by a loaded file
+	inline bool probe(const Board* board, Player player, TablebaseResult& result) const {
+		size_t index;
+		int ending = tablebaseIndex(board, player, index);
+		if (ending == TABLEBASE_DRAWN) {
+			result.result = result.plies = 0;
+			return true;
+		}
+		if (ending == TABLEBASE_NONE || !tables[ending])
+			return false;
+
+		const uint8_t value = tables[ending][index];
+		result.plies = value ? value - 1 : 0;
+		result.result = value == 0 ? 0 : (result.plies & 1) ? 1 : -1;
+		return true;
+	}
+
+private:
+	const uint8_t* tables[TABLEBASE_ENDINGS];
+};
+
+// the ones the heuristics probe, nothing open until -tablebases
+extern Tablebases tablebases;
+
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include "tablebase.h"
+
+using namespace std;
+
+/*
+	tbgen
+	builds the endgame tablebases by retrograde analysis: every position of an
+	ending is listed with the positions its moves lead to, then starting from
+	the mates, pass n finds the positions that are won in n plies (a move to
+	one lost in n - 1) or lost in n plies (every move goes to one already won,
+	the longest taking n - 1). whatever is left when the passes stop finding
+	any is a draw. kpk promotes into kqk and krk so those are built first.
+*/
+typedef int16_t Distance; // plies to mate, NO_DISTANCE for draws and unknowns
+const Distance NO_DISTANCE = -1;
+
+// a position a move leads to, ending and index packed together
+inline uint32_t childPack(int ending, size_t index) {
+	return (uint32_t) ending << 20 | (uint32_t) index;
+}
+
+struct Generator {
+	vector<Distance> distances[chess::TABLEBASE_ENDINGS];
+
+	/*
+		sets up the position at index of ending on board, false if it can't
+		occur: pieces on top of each other, kings touching, a pawn on the back
+		rank or the side that just moved left in check
+	*/
+	bool setup(chess::Board& board, int ending, size_t index, chess::Player& player) {
+		const int square = index & 63;
+		const int weakKing = (index >> 6) & 63;
+		const int strongKing = (index >> 12) & 63;
+		player = (index >> 18) ? -1 : 1;
+
+		if (square == weakKing || square == strongKing || weakKing == strongKing)
+			return false;
+		if (chess::stepAttacks.king[strongKing] & (1ULL << weakKing))
+			return false;
+		if (ending == chess::TABLEBASE_KPK && (square < 8 || square >= 56))
+			return false;
+
+		const chess::Piece pieces[] = { chess::PIECE_QUEEN, chess::PIECE_ROOK, chess::PIECE_PAWN };
+		for (int i = 0; i < chess::BOARD_SPACES; ++i)
+			board.pieces[i] = chess::PIECE_EMPTY;
+		board.pieces[strongKing] = chess::PIECE_KING;
+		board.pieces[weakKing] = -chess::PIECE_KING;
+		board.pieces[square] = pieces[ending];
+		board.castling = 0;
+		board.enPassant = -1;
+		board.synchronize();
+		return !board.isInCheck(-player);
+	}
+
+	inline Distance getDistance(uint32_t child) const {
+		const int ending = child >> 20;
+		if (ending == chess::TABLEBASE_DRAWN)
+			return NO_DISTANCE;
+		return distances[ending][child & ((1 << 20) - 1)];
+	}
+
+	void generate(int ending) {
+		auto start = chrono::steady_clock::now();
+		vector<Distance>& distance = distances[ending];
+		distance.assign(chess::TABLEBASE_SIZE, NO_DISTANCE);
+
+		// the positions every move leads to, and the mates
+		vector<uint32_t> childStart(chess::TABLEBASE_SIZE + 1, 0);
+		vector<uint32_t> children;
+		vector<size_t> open; // positions still to be decided
+		Distance longestOther = 0; // the passes have to reach the longest mate they can lead into
+		chess::Board board;
+		for (size_t index = 0; index < chess::TABLEBASE_SIZE; ++index) {
+			childStart[index] = (uint32_t) children.size();
+			chess::Player player;
+			if (!setup(board, ending, index, player))
+				continue;
+
+			chess::MoveList moves;
+			chess::generateMoves(&board, player, moves);
+			for (int i = 0; i < moves.moveCount; ++i) {
+				chess::Move move = moves.getMove(i);
+				chess::Move::Undo undo;
+				move.apply(&board, undo);
+				size_t childIndex = 0;
+				int childEnding = chess::tablebaseIndex(&board, -player, childIndex);
+				move.revert(&board, undo);
+
+				children.push_back(childPack(childEnding, childIndex));
+				if (childEnding != ending && childEnding < chess::TABLEBASE_ENDINGS) {
+					Distance other = distances[childEnding][childIndex];
+					if (other > longestOther)
+						longestOther = other;
+				}
+			}
+
+			if (moves.moveCount == 0) {
+				if (board.isInCheck(player))
+					distance[index] = 0; // mated, stalemates are left as draws
+			} else {
+				open.push_back(index);
+			}
+		}
+		childStart[chess::TABLEBASE_SIZE] = (uint32_t) children.size();
+
+		Distance longest = 0;
+		for (Distance ply = 1; ; ++ply) {
+			vector<size_t> stillOpen;
+			vector<pair<size_t, Distance>> decided;
+			for (size_t index : open) {
+				bool won = false, lost = true;
+				for (uint32_t i = childStart[index]; i < childStart[index + 1]; ++i) {
+					Distance child = getDistance(children[i]);
+					if (child == ply - 1 && (child & 1) == 0)
+						won = true;
+					// lost only once every move is known to lose, the longest in ply - 1
+					if (child == NO_DISTANCE || (child & 1) == 0 || child > ply - 1)
+						lost = false;
+				}
+				if ((ply & 1) ? won : lost)
+					decided.push_back(make_pair(index, ply));
+				else
+					stillOpen.push_back(index);
+			}
+
+			// written after the pass so every position in it sees the previous ply only
+			for (const auto& position : decided)
+				distance[position.first] = position.second;
+			if (!decided.empty())
+				longest = ply;
+			open.swap(stillOpen);
+			if (decided.empty() && ply > longestOther + 1)
+				break;
+		}
+
+		cout << chess::tablebaseName(ending) << ": " << open.size() << " draws, longest mate " << longest << " plies, "
+			<< chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count() << "ms" << endl;
+	}
+
+	bool write(int ending, const string& directory) {
+		vector<uint8_t> values(chess::TABLEBASE_SIZE);
+		for (size_t i = 0; i < chess::TABLEBASE_SIZE; ++i) {
+			Distance d = distances[ending][i];
+			if (d >= UINT8_MAX) {
+				cerr << "mate too long to store: " << d << " plies" << endl;
+				return false;
+			}
+			values[i] = d == NO_DISTANCE ? 0 : (uint8_t) (d + 1);
+		}
+
+		const string path = directory + "/" + chess::tablebaseName(ending) + ".tb";
+		ofstream file(path, ios::binary);
+		file.write((const char*) values.data(), values.size());
+		if (!file) {
+			cerr << "could not write " << path << endl;
+			return false;
+		}
+		return true;
+	}
+};
+
+int main(int argc, const char** args) {
+	if (argc != 2) {
+		cerr << "usage: " << args[0] << " <directory>" << endl;
+		return 1;
+	}
+
+	Generator generator;
+	for (int ending = 0; ending < chess::TABLEBASE_ENDINGS; ++ending) {
+		generator.generate(ending);
+		if (!generator.write(ending, args[1]))
+			return 1;
+	}
+	return 0;
+}
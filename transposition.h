@@ -0,0 +1,253 @@
+#ifndef __TRANSPOSITION_H_
+#define __TRANSPOSITION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+namespace minimax {
+
+/*
+	TranspositionTable
+	fixed size hash table of search results shared by every search using it
+	 - buckets are one cache line holding 4 entries
+	 - entries are two 64 bit words, the key word is stored xor'd with the data
+	   word, so a torn write from a concurrent store simply fails to validate
+	   and no locking is needed
+	 - scores are stored from the perspective of the player to move
+	 - mate scores are stored counted from the entry's own node, see
+	   toTableScore
+	usage:
+		- probe before expanding a node
+		- store once the node has been searched
+		- call newSearch at the start of each search to age old entries
+*/
+struct TranspositionTable {
+	enum Bound : uint8_t {
+		BOUND_NONE = 0, BOUND_UPPER = 1, BOUND_LOWER = 2, BOUND_EXACT = 3
+	};
+
+	// decoded contents of an entry
+	struct Entry {
+		uint16_t move;
+		int32_t score;
+		int8_t depth;
+		Bound bound;
+	};
+
+	// counters are owned by whoever is searching so threads never share a cache line
+	struct Counters {
+		uint64_t probes = 0;
+		uint64_t hits = 0;
+		uint64_t stores = 0;
+		uint64_t collisions = 0; // a store evicted a live entry for another position
+
+		inline void reset() {
+			probes = hits = stores = collisions = 0;
+		}
+
+		inline Counters& operator+=(const Counters& other) {
+			probes += other.probes;
+			hits += other.hits;
+			stores += other.stores;
+			collisions += other.collisions;
+			return *this;
+		}
+	};
+
+	static const int BUCKET_SIZE = 4;
+
+	struct Slot {
+		std::atomic<uint64_t> key; // hash ^ data
+		std::atomic<uint64_t> data;
+	};
+
+	struct alignas(64) Bucket {
+		Slot slots[BUCKET_SIZE];
+	};
+
+	TranspositionTable(size_t megabytes) : buckets(nullptr), bucketCount(0), generation(0) {
+		resize(megabytes);
+	}
+
+	~TranspositionTable() {
+		std::free(buckets);
+	}
+
+	TranspositionTable(const TranspositionTable&) = delete;
+	TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+	/*
+		resizes the table to the largest power of two bucket count that fits,
+		not safe to call while a search is using the table
+	*/
+	void resize(size_t megabytes) {
+		std::free(buckets);
+		buckets = nullptr;
+
+		size_t count = 1;
+		while (count * 2 * sizeof(Bucket) <= megabytes * 1024 * 1024)
+			count *= 2;
+
+		void* memory = nullptr;
+		if (posix_memalign(&memory, sizeof(Bucket), count * sizeof(Bucket)) != 0)
+			throw std::bad_alloc();
+		buckets = new (memory) Bucket[count];
+		bucketCount = count;
+		clear();
+	}
+
+	void clear() {
+		for (size_t i = 0; i < bucketCount; ++i) {
+			for (int j = 0; j < BUCKET_SIZE; ++j) {
+				buckets[i].slots[j].key.store(0, std::memory_order_relaxed);
+				buckets[i].slots[j].data.store(0, std::memory_order_relaxed);
+			}
+		}
+		generation = 0;
+	}
+
+	inline void newSearch() {
+		generation = (generation + 1) & GENERATION_MASK;
+	}
+
+	inline size_t getSizeBytes() const {
+		return bucketCount * sizeof(Bucket);
+	}
+
+	/*
+		mate scores count plies from the root, so the same position scores
+		differently at each ply it turns up at. entries count them from their
+		own node instead: toTableScore before a store and fromTableScore after
+		a probe, with the score of mate at the root. anything within MATE_RANGE
+		of it is a mate, tablebase mates can be further off than MAX_PLY.
+	*/
+	static const int32_t MATE_RANGE = 1000;
+
+	static inline int32_t toTableScore(int32_t score, int ply, int32_t scoreMate) {
+		if (score >= scoreMate - MATE_RANGE)
+			return score + ply;
+		if (score <= -scoreMate + MATE_RANGE)
+			return score - ply;
+		return score;
+	}
+
+	static inline int32_t fromTableScore(int32_t score, int ply, int32_t scoreMate) {
+		if (score >= scoreMate - MATE_RANGE)
+			return score - ply;
+		if (score <= -scoreMate + MATE_RANGE)
+			return score + ply;
+		return score;
+	}
+
+	inline bool probe(uint64_t hash, Entry& entry, Counters& counters) const {
+		counters.probes++;
+		const Bucket& bucket = buckets[hash & (bucketCount - 1)];
+		for (int i = 0; i < BUCKET_SIZE; ++i) {
+			uint64_t data = bucket.slots[i].data.load(std::memory_order_relaxed);
+			uint64_t key = bucket.slots[i].key.load(std::memory_order_relaxed);
+			if ((key ^ data) == hash && dataGetBound(data) != BOUND_NONE) {
+				counters.hits++;
+				entry.move = dataGetMove(data);
+				entry.score = dataGetScore(data);
+				entry.depth = dataGetDepth(data);
+				entry.bound = dataGetBound(data);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline void store(uint64_t hash, uint16_t move, int32_t score, int depth, Bound bound, Counters& counters) {
+		counters.stores++;
+		Bucket& bucket = buckets[hash & (bucketCount - 1)];
+
+		// prefer the slot already holding this position, otherwise the
+		// shallowest and oldest entry in the bucket
+		Slot* replace = nullptr;
+		int replaceValue = INT32_MAX;
+		uint64_t replaceData = 0;
+		for (int i = 0; i < BUCKET_SIZE; ++i) {
+			uint64_t data = bucket.slots[i].data.load(std::memory_order_relaxed);
+			uint64_t key = bucket.slots[i].key.load(std::memory_order_relaxed);
+			if ((key ^ data) == hash) {
+				// keep the old best move if we did not find one this time
+				if (move == 0)
+					move = dataGetMove(data);
+				// don't clobber a deeper result from this search with a shallow bound
+				if (bound != BOUND_EXACT && dataGetGeneration(data) == generation && dataGetDepth(data) > depth + 2)
+					return;
+				replace = &bucket.slots[i];
+				replaceData = 0;
+				break;
+			}
+
+			int value = dataGetBound(data) == BOUND_NONE ? INT32_MIN :
+				dataGetDepth(data) - 8 * (int) ((generation - dataGetGeneration(data)) & GENERATION_MASK);
+			if (value < replaceValue) {
+				replace = &bucket.slots[i];
+				replaceValue = value;
+				replaceData = data;
+			}
+		}
+
+		if (dataGetBound(replaceData) != BOUND_NONE)
+			counters.collisions++;
+
+		uint64_t data = makeData(move, score, depth, bound);
+		replace->data.store(data, std::memory_order_relaxed);
+		replace->key.store(hash ^ data, std::memory_order_relaxed);
+	}
+
+	/*
+		approximate fill rate in entries per thousand, sampled from the first
+		buckets of the table
+	*/
+	int hashfull() const {
+		size_t sample = bucketCount < 1000 ? bucketCount : 1000;
+		int used = 0;
+		for (size_t i = 0; i < sample; ++i) {
+			for (int j = 0; j < BUCKET_SIZE; ++j) {
+				uint64_t data = buckets[i].slots[j].data.load(std::memory_order_relaxed);
+				if (dataGetBound(data) != BOUND_NONE && dataGetGeneration(data) == generation)
+					used++;
+			}
+		}
+		return (int) (used * 1000 / (sample * BUCKET_SIZE));
+	}
+
+private:
+	/*
+		data word layout
+			bits  0-15 move
+			bits 16-47 score
+			bits 48-55 depth
+			bits 56-57 bound
+			bits 58-63 generation
+	*/
+	static const uint8_t GENERATION_MASK = 0x3f;
+
+	inline uint64_t makeData(uint16_t move, int32_t score, int depth, Bound bound) const {
+		return (uint64_t) move
+			| ((uint64_t) (uint32_t) score << 16)
+			| ((uint64_t) (uint8_t) depth << 48)
+			| ((uint64_t) bound << 56)
+			| ((uint64_t) generation << 58);
+	}
+
+	static inline uint16_t dataGetMove(uint64_t data) { return (uint16_t) data; }
+	static inline int32_t dataGetScore(uint64_t data) { return (int32_t) (uint32_t) (data >> 16); }
+	static inline int8_t dataGetDepth(uint64_t data) { return (int8_t) (uint8_t) (data >> 48); }
+	static inline Bound dataGetBound(uint64_t data) { return (Bound) ((data >> 56) & 0x3); }
+	static inline uint8_t dataGetGeneration(uint64_t data) { return (uint8_t) (data >> 58); }
+
+	Bucket* buckets;
+	size_t bucketCount;
+	uint8_t generation;
+};
+
+}
+
+#endif
@@ -0,0 +1,407 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include "chessboard.h"
+#include "book.h"
+#include "tablebase.h"
+#include "chessgame.h"
+#include "transposition.h"
+#include "search.h"
+#include "parallel.h"
+
+using namespace std;
+
+/*
+	uci
+	the engine behind the universal chess interface, for guis and match
+	runners. commands are read on the main thread while a search runs on a
+	worker thread, so stop, isready and quit are answered straight away and
+	the engine can stay up for any number of games.
+
+	the transposition table and move ordering are kept from search to search,
+	so each one starts warm from the last. with pondering on the engine keeps
+	searching the reply it expects while the opponent thinks: on ponderhit the
+	real search starts from a table the ponder search already filled.
+*/
+
+// every line goes out whole, the worker and the command loop both write
+mutex outputLock;
+
+void send(const string& line) {
+	lock_guard<mutex> lock(outputLock);
+	cout << line << endl;
+}
+
+struct UciEngine {
+	typedef minimax::ParallelSearch<ChessGameTypes> SearchType;
+
+	static const int64_t MOVE_OVERHEAD = 30; // milliseconds kept back for talking to the gui
+	static const int MOVES_TO_GO = 30;       // moves the remaining time is shared between when the gui doesn't say
+
+	int hashMegabytes;
+	int threads;
+	unique_ptr<minimax::TranspositionTable> table;
+	unique_ptr<SearchType> search;
+
+	chess::Board board;
+	ChessPlayer player;
+	vector<string> moves;         // played from the start position to reach board, after the fen if there was one
+	vector<string> searchedMoves; // the moves of the last position searched
+
+	chess::OpeningBook book;
+	minstd_rand bookRandom;
+
+	thread worker;
+	atomic<bool> stop;
+	atomic<bool> infinite; // go infinite or ponder, bestmove waits for stop even when the search ends first
+	atomic<bool> report;   // false once a ponder search is stopped by ponderhit, its move is never played
+	chess::Move ponderMove; // the reply the last iteration expects, written by the worker
+
+	// the search to start on ponderhit
+	bool pondering;
+	minimax::SearchLimits ponderLimits;
+
+	UciEngine() : hashMegabytes(64), threads(1), player(1), bookRandom(random_device{}()), stop(false), infinite(false), report(true), pondering(false) {
+		table.reset(new minimax::TranspositionTable(hashMegabytes));
+		resetSearch();
+	}
+
+	~UciEngine() {
+		stopSearch();
+	}
+
+	void resetSearch() {
+		search.reset(new SearchType(table.get(), threads));
+		search->stop = &stop;
+	}
+
+	void stopSearch() {
+		stop = true;
+		infinite = false;
+		if (worker.joinable())
+			worker.join();
+		pondering = false;
+	}
+
+	/*
+		plies from the last position searched to this one, -1 when this one
+		doesn't follow from it
+	*/
+	int pliesSinceSearch() const {
+		if (searchedMoves.size() > moves.size())
+			return -1;
+		for (size_t i = 0; i < searchedMoves.size(); ++i) {
+			if (searchedMoves[i] != moves[i])
+				return -1;
+		}
+		return (int) (moves.size() - searchedMoves.size());
+	}
+
+	void uci() {
+		send("id name Chess Engine v2");
+		send("id author Gareth George");
+		send("option name Hash type spin default 64 min 1 max 65536");
+		send("option name Threads type spin default 1 min 1 max 256");
+		send("option name Ponder type check default false");
+		send("option name BookFile type string default <empty>");
+		send("option name TablebasePath type string default <empty>");
+		send("option name EvalFile type string default <empty>");
+		send("uciok");
+	}
+
+	// setoption name <name> value <value>, names may have spaces in them
+	void setOption(istringstream& command) {
+		string word, name, value;
+		command >> word;
+		while (command >> word && word != "value")
+			name += (name.empty() ? "" : " ") + word;
+		getline(command >> ws, value);
+
+		if (name == "Hash") {
+			hashMegabytes = atoi(value.c_str());
+			table->resize(hashMegabytes);
+		} else if (name == "Threads") {
+			threads = atoi(value.c_str());
+			resetSearch();
+		} else if (name == "Ponder") {
+			// nothing to set up, the gui decides when to ponder
+		} else if (name == "BookFile") {
+			if (value.empty() || value == "<empty>")
+				book.close();
+			else if (!book.open(value.c_str()))
+				send("info string could not load book " + value);
+		} else if (name == "TablebasePath") {
+			if (value.empty() || value == "<empty>")
+				chess::tablebases.close();
+			else if (chess::tablebases.open(value.c_str()) == 0)
+				send("info string no tablebases found in " + value);
+		} else if (name == "EvalFile") {
+			if (value.empty() || value == "<empty>")
+				chess::nnueUnload();
+			else if (!chess::nnueLoad(value.c_str()))
+				send("info string could not load network " + value);
+			board.synchronize();
+		} else {
+			send("info string unknown option " + name);
+		}
+	}
+
+	// position startpos|fen <fen> [moves ...]
+	void position(istringstream& command) {
+		string word;
+		command >> word;
+		chess::Board newBoard;
+		ChessPlayer newPlayer(1);
+		string fen;
+		if (word == "fen") {
+			while (command >> word && word != "moves")
+				fen += (fen.empty() ? "" : " ") + word;
+			chess::Player fenPlayer;
+			if (!chess::parseFen(fen.c_str(), &newBoard, fenPlayer)) {
+				send("info string invalid fen " + fen);
+				return;
+			}
+			newPlayer = ChessPlayer(fenPlayer);
+		} else if (word == "startpos") {
+			command >> word; // moves
+		} else {
+			send("info string unknown position " + word);
+			return;
+		}
+
+		// nothing changes unless every move is legal
+		vector<string> newMoves;
+		// searches only follow on from one another from the same start
+		if (!fen.empty())
+			newMoves.push_back("fen " + fen);
+		while (command >> word) {
+			chess::Move move;
+			if (!chess::parseMove(&newBoard, newPlayer.player, word, move)) {
+				send("info string illegal move " + word);
+				return;
+			}
+			chess::Move::Undo undo;
+			move.apply(&newBoard, undo);
+			newPlayer = newPlayer.getOpponent();
+			newMoves.push_back(word);
+		}
+
+		board = newBoard;
+		player = newPlayer;
+		moves = newMoves;
+	}
+
+	/*
+		share the time left between the moves still to play, plus most of the
+		increment, never using so much the clock runs out
+	*/
+	static int64_t allocateTime(int64_t remaining, int64_t increment, int movesToGo) {
+		if (movesToGo <= 0)
+			movesToGo = MOVES_TO_GO;
+		int64_t time = remaining / movesToGo + increment * 3 / 4;
+		if (time > remaining - MOVE_OVERHEAD)
+			time = remaining - MOVE_OVERHEAD;
+		return time < 1 ? 1 : time;
+	}
+
+	static string formatScore(int score) {
+		const int SCORE_MATE = ChessGameTypes::HeuristicType::SCORE_MATE;
+		const int MATE_BOUND = SCORE_MATE - 1000; // tablebase mates can be further off than MAX_PLY
+		if (score >= MATE_BOUND)
+			return "mate " + to_string((SCORE_MATE - score + 1) / 2);
+		if (score <= -MATE_BOUND)
+			return "mate -" + to_string((SCORE_MATE + score) / 2);
+		return "cp " + to_string(score);
+	}
+
+	void printIteration(const minimax::Search<ChessGameTypes>::Iteration& iteration) {
+		ostringstream line;
+		line << "info depth " << iteration.depth
+			<< " score " << formatScore(iteration.score)
+			<< " nodes " << iteration.nodes
+			<< " nps " << iteration.nodes * 1000 / (iteration.milliseconds > 0 ? iteration.milliseconds : 1)
+			<< " time " << iteration.milliseconds
+			<< " hashfull " << table->hashfull()
+			<< " pv";
+		for (int i = 0; i < iteration.pvLength; ++i)
+			line << " " << iteration.pv[i].toCoordinate();
+		send(line.str());
+
+		ponderMove = iteration.pvLength > 1 ? iteration.pv[1] : chess::Move();
+	}
+
+	// go [ponder] [wtime n] [btime n] [winc n] [binc n] [movestogo n] [movetime n] [depth n] [nodes n] [infinite]
+	void go(istringstream& command) {
+		stopSearch();
+
+		minimax::SearchLimits limits;
+		int64_t time[2] = { 0, 0 }, increment[2] = { 0, 0 };
+		int movesToGo = 0;
+		bool searchInfinite = false, ponder = false;
+		string word;
+		while (command >> word) {
+			if (word == "wtime")
+				command >> time[0];
+			else if (word == "btime")
+				command >> time[1];
+			else if (word == "winc")
+				command >> increment[0];
+			else if (word == "binc")
+				command >> increment[1];
+			else if (word == "movestogo")
+				command >> movesToGo;
+			else if (word == "movetime")
+				command >> limits.milliseconds;
+			else if (word == "depth")
+				command >> limits.depth;
+			else if (word == "nodes")
+				command >> limits.nodes;
+			else if (word == "infinite")
+				searchInfinite = true;
+			else if (word == "ponder")
+				ponder = true;
+		}
+
+		const int side = player.getIndex();
+		if (!searchInfinite && limits.milliseconds == 0 && time[side] > 0)
+			limits.milliseconds = allocateTime(time[side], increment[side], movesToGo);
+
+		// ponder without limits, the real ones apply from ponderhit
+		if (ponder) {
+			ponderLimits = limits;
+			limits = minimax::SearchLimits();
+			searchInfinite = true;
+		}
+
+		chess::Move move;
+		if (!searchInfinite && book.probe(&board, player.player, (uint32_t) bookRandom(), move)) {
+			send("info string book move");
+			send("bestmove " + move.toCoordinate());
+			return;
+		}
+
+		start(limits, searchInfinite);
+		pondering = ponder;
+	}
+
+	void start(const minimax::SearchLimits& limits, bool searchInfinite) {
+		stop = false;
+		infinite = searchInfinite;
+		report = true;
+		ponderMove = chess::Move();
+		search->newSearch(pliesSinceSearch());
+		searchedMoves = moves;
+		search->onIteration = [this](const minimax::Search<ChessGameTypes>::Iteration& iteration) {
+			printIteration(iteration);
+		};
+
+		chess::Board searchBoard = board;
+		ChessPlayer searchPlayer = player;
+		worker = thread([this, searchBoard, searchPlayer, limits]() mutable {
+			chess::Move best;
+			search->iterate(&searchBoard, searchPlayer, limits, best);
+
+			// the gui asked for no bestmove until it says stop
+			while (infinite && !stop)
+				this_thread::sleep_for(chrono::milliseconds(1));
+
+			if (!report)
+				return;
+			if (minimax::SearchStats::ENABLED) {
+				ostringstream stats;
+				search->writeStats(stats);
+				send("info string stats " + stats.str());
+			}
+			string line = "bestmove " + (best.isNull() ? string("0000") : best.toCoordinate());
+			if (!best.isNull()) {
+				chess::Move reply = ponderMove.isNull() ? tableReply(searchBoard, searchPlayer, best) : ponderMove;
+				if (!reply.isNull())
+					line += " ponder " + reply.toCoordinate();
+			}
+			send(line);
+		});
+	}
+
+	// table cutoffs cut the principal variation short, the reply can still be in the table
+	chess::Move tableReply(chess::Board board, ChessPlayer player, chess::Move move) {
+		chess::Move::Undo undo;
+		move.apply(&board, undo);
+		player = player.getOpponent();
+
+		minimax::TranspositionTable::Entry entry;
+		minimax::TranspositionTable::Counters counters;
+		if (table->probe(board.getHash() ^ player.getHash(), entry, counters)) {
+			chess::Move reply(entry.move);
+			if (chess::isLegal(&board, player.player, reply))
+				return reply;
+		}
+		return chess::Move();
+	}
+
+	/*
+		the opponent played the expected move: the ponder search is dropped and
+		the real one started on the same position, finding what it needs in
+		the table
+	*/
+	void ponderHit() {
+		if (!pondering)
+			return;
+		minimax::SearchLimits limits = ponderLimits;
+		report = false;
+		stopSearch();
+		start(limits, false);
+	}
+
+	// returns false on quit
+	bool handle(const string& line) {
+		istringstream command(line);
+		string word;
+		if (!(command >> word))
+			return true;
+
+		if (word == "uci") {
+			uci();
+		} else if (word == "isready") {
+			send("readyok");
+		} else if (word == "setoption") {
+			stopSearch();
+			setOption(command);
+		} else if (word == "ucinewgame") {
+			stopSearch();
+			search->clear();
+		} else if (word == "position") {
+			stopSearch();
+			position(command);
+		} else if (word == "go") {
+			go(command);
+		} else if (word == "ponderhit") {
+			ponderHit();
+		} else if (word == "stop") {
+			stopSearch();
+		} else if (word == "quit") {
+			stopSearch();
+			return false;
+		} else {
+			send("info string unknown command " + word);
+		}
+		return true;
+	}
+};
+
+int main() {
+	UciEngine engine;
+	string line;
+	while (getline(cin, line)) {
+		if (!engine.handle(line))
+			break;
+	}
+	return 0;
+}